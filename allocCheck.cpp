@@ -0,0 +1,121 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: allocCheck.cpp
+//
+// Checks that playing a shot makes no heap allocation. Global operator new
+// and delete are replaced by counting versions, the standard four-ball
+// table is racked, and a shot is played to rest under every solver and
+// ball model while the count is watched. Racking may allocate; every step
+// after the stroke must not. Exits non-zero when a shot allocated.
+//
+//   allocCheck
+//
+// Built as the allocCheck target of CMakeLists.txt, which also runs it
+// under ctest.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "billiardSim.h"
+#include "rules.h"
+#include "table.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace sim;
+
+static long long g_allocations = 0;
+
+void* operator new(size_t size)
+{
+	g_allocations++;
+	void* p = malloc(size == 0 ? 1 : size);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+// the standard table with the four-ball rack, as Table sets it up
+static void rack(World& world)
+{
+	for (int i = 0; i < Table::RAIL_COUNT; i++)
+		world.cushions().addBox(Table::RAILS[i][0], Table::RAILS[i][1], Table::RAILS[i][2], Table::RAILS[i][3]);
+	world.cushions().build(world.getRadius());
+	const Rules& rules = rulesFor(FOUR_BALL);
+	world.reset((const float(*)[2])rules.rack(), rules.ballCount());
+}
+
+// allocations of a shot of the cue ball at angle, as hard as a player can
+// strike it (Table::MAX_SPEED), stepped at 120 Hz until every ball is at
+// rest
+static long long shotAllocations(World::Solver solver, World::Model model, float angle)
+{
+	World world;
+	world.setSolver(solver);
+	world.setModel(model);
+	world.setFixedStep(1.0f / 120);
+	rack(world);
+
+	const int cueBall = rulesFor(FOUR_BALL).cueBall(0);
+	long long before = g_allocations;
+	world.clearContacts();
+	world.strike(cueBall, CueStroke(Vec2(cosf(angle), sinf(angle)), 11));
+	for (int k = 0; k < 120 * 120 && !world.isStopped(); k++)
+		world.step(1.0f / 120);
+	return g_allocations - before;
+}
+
+int main(void)
+{
+	struct Case {
+		const char*     name;
+		World::Solver   solver;
+		World::Model    model;
+	};
+	const Case cases[] = {
+		{ "fixed step, damped", World::FIXED_STEP, World::DAMPED },
+		{ "event driven, damped", World::EVENT_DRIVEN, World::DAMPED },
+		{ "rigid", World::FIXED_STEP, World::RIGID },
+	};
+
+	int failed = 0;
+	for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+		// shots at a spread of angles, so cushions and balls both get hit
+		long long worst = 0;
+		for (int k = 0; k < 64; k++) {
+			long long n = shotAllocations(cases[c].solver, cases[c].model, (float)k * (6.2831853f / 64));
+			if (n > worst)
+				worst = n;
+		}
+		printf("%-24s %lld allocations per shot at most\n", cases[c].name, worst);
+		if (worst > 0)
+			failed++;
+	}
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,756 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: billiardSim.cpp
+//
+// Headless simulation core of Virtual Billiard. See billiardSim.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "billiardSim.h"
+#include "eventSolver.h"
+#include "profiler.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(SIM_DOUBLE)
+// the kernels below work on float lanes; a double table takes the scalar ones
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define SIM_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIM_SSE2
+#endif
+
+namespace sim
+{
+	// -------------------------------------------------------------------------
+	// BallStore
+	// -------------------------------------------------------------------------
+
+	void BallStore::resize(int count)
+	{
+		int padded = (count + LANES - 1) / LANES * LANES;
+		m_count = count;
+		x.assign(padded, 0.0f);
+		z.assign(padded, 0.0f);
+		vx.assign(padded, 0.0f);
+		vz.assign(padded, 0.0f);
+		rx.assign(padded, 0.0f);
+		rz.assign(padded, 0.0f);
+		w.assign(padded, 0.0f);
+	}
+
+	// -------------------------------------------------------------------------
+	// integration kernel
+	// -------------------------------------------------------------------------
+
+	// a ball moves while either velocity component is above STOP_SPEED,
+	// otherwise it is stopped. moving balls are kept within the limits of the
+	// cushions, so a fast one cannot leave the table between two steps.
+	static Real dampingRate(Real timeDiff, Real damping)
+	{
+		Real rate = 1 - damping * timeDiff;
+		return rate < 0 ? 0 : rate;
+	}
+
+#if defined(SIM_AVX)
+	void integrate(BallStore& balls, Real timeDiff, Real damping, const Extent& limits, const int* blocks, int blockCount)
+	{
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		const __m256 stop = _mm256_set1_ps(STOP_SPEED);
+		const __m256 scale = _mm256_set1_ps(TIME_SCALE * timeDiff);
+		const __m256 rate = _mm256_set1_ps(dampingRate(timeDiff, damping));
+		const __m256 maxX = _mm256_set1_ps(limits.maxX), minX = _mm256_set1_ps(limits.minX);
+		const __m256 maxZ = _mm256_set1_ps(limits.maxZ), minZ = _mm256_set1_ps(limits.minZ);
+		float *px = &balls.x[0], *pz = &balls.z[0], *pvx = &balls.vx[0], *pvz = &balls.vz[0];
+
+		for (int k = 0; k < blockCount; k++) {
+			int i = (blocks ? blocks[k] : k) * BallStore::LANES;
+			__m256 x = _mm256_loadu_ps(px + i), z = _mm256_loadu_ps(pz + i);
+			__m256 vx = _mm256_loadu_ps(pvx + i), vz = _mm256_loadu_ps(pvz + i);
+
+			__m256 moving = _mm256_or_ps(_mm256_cmp_ps(_mm256_andnot_ps(sign, vx), stop, _CMP_GT_OQ),
+				_mm256_cmp_ps(_mm256_andnot_ps(sign, vz), stop, _CMP_GT_OQ));
+			__m256 tx = _mm256_add_ps(x, _mm256_mul_ps(scale, vx));
+			__m256 tz = _mm256_add_ps(z, _mm256_mul_ps(scale, vz));
+			tx = _mm256_max_ps(_mm256_min_ps(tx, maxX), minX);
+			tz = _mm256_max_ps(_mm256_min_ps(tz, maxZ), minZ);
+
+			_mm256_storeu_ps(px + i, _mm256_blendv_ps(x, tx, moving));
+			_mm256_storeu_ps(pz + i, _mm256_blendv_ps(z, tz, moving));
+			_mm256_storeu_ps(pvx + i, _mm256_and_ps(_mm256_mul_ps(vx, rate), moving));
+			_mm256_storeu_ps(pvz + i, _mm256_and_ps(_mm256_mul_ps(vz, rate), moving));
+		}
+	}
+#elif defined(SIM_SSE2)
+	void integrate(BallStore& balls, Real timeDiff, Real damping, const Extent& limits, const int* blocks, int blockCount)
+	{
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		const __m128 stop = _mm_set1_ps(STOP_SPEED);
+		const __m128 scale = _mm_set1_ps(TIME_SCALE * timeDiff);
+		const __m128 rate = _mm_set1_ps(dampingRate(timeDiff, damping));
+		const __m128 maxX = _mm_set1_ps(limits.maxX), minX = _mm_set1_ps(limits.minX);
+		const __m128 maxZ = _mm_set1_ps(limits.maxZ), minZ = _mm_set1_ps(limits.minZ);
+		float *px = &balls.x[0], *pz = &balls.z[0], *pvx = &balls.vx[0], *pvz = &balls.vz[0];
+
+		for (int k = 0; k < blockCount; k++) {
+			int first = (blocks ? blocks[k] : k) * BallStore::LANES;
+			for (int i = first; i < first + BallStore::LANES; i += 4) {
+				__m128 x = _mm_loadu_ps(px + i), z = _mm_loadu_ps(pz + i);
+				__m128 vx = _mm_loadu_ps(pvx + i), vz = _mm_loadu_ps(pvz + i);
+
+				__m128 moving = _mm_or_ps(_mm_cmpgt_ps(_mm_andnot_ps(sign, vx), stop),
+					_mm_cmpgt_ps(_mm_andnot_ps(sign, vz), stop));
+				__m128 tx = _mm_add_ps(x, _mm_mul_ps(scale, vx));
+				__m128 tz = _mm_add_ps(z, _mm_mul_ps(scale, vz));
+				tx = _mm_max_ps(_mm_min_ps(tx, maxX), minX);
+				tz = _mm_max_ps(_mm_min_ps(tz, maxZ), minZ);
+
+				_mm_storeu_ps(px + i, _mm_or_ps(_mm_and_ps(moving, tx), _mm_andnot_ps(moving, x)));
+				_mm_storeu_ps(pz + i, _mm_or_ps(_mm_and_ps(moving, tz), _mm_andnot_ps(moving, z)));
+				_mm_storeu_ps(pvx + i, _mm_and_ps(_mm_mul_ps(vx, rate), moving));
+				_mm_storeu_ps(pvz + i, _mm_and_ps(_mm_mul_ps(vz, rate), moving));
+			}
+		}
+	}
+#else
+	void integrate(BallStore& balls, Real timeDiff, Real damping, const Extent& limits, const int* blocks, int blockCount)
+	{
+		const Real scale = TIME_SCALE * timeDiff;
+		const Real rate = dampingRate(timeDiff, damping);
+
+		for (int k = 0; k < blockCount; k++) {
+			int first = (blocks ? blocks[k] : k) * BallStore::LANES;
+			for (int i = first; i < first + BallStore::LANES; i++) {
+				if (std::fabs(balls.vx[i]) > STOP_SPEED || std::fabs(balls.vz[i]) > STOP_SPEED) {
+					balls.x[i] = std::max(limits.minX, std::min(balls.x[i] + scale * balls.vx[i], limits.maxX));
+					balls.z[i] = std::max(limits.minZ, std::min(balls.z[i] + scale * balls.vz[i], limits.maxZ));
+					balls.vx[i] *= rate;
+					balls.vz[i] *= rate;
+				}
+				else {
+					balls.vx[i] = 0;
+					balls.vz[i] = 0;
+				}
+			}
+		}
+	}
+#endif
+
+	void integrate(BallStore& balls, Real timeDiff, Real damping, const Extent& limits)
+	{
+		integrate(balls, timeDiff, damping, limits, NULL, balls.paddedSize() / BallStore::LANES);
+	}
+
+	// -------------------------------------------------------------------------
+	// rigid-ball kernel
+	// -------------------------------------------------------------------------
+
+	// the cloth pushes against the slip u = v - r of the point the ball
+	// touches it with. a sliding ball loses slide * dt of velocity along u
+	// and its spin gains 5/2 of that (a solid sphere), so the slip shrinks by
+	// 7/2 * slide * dt a step and never turns. once it would vanish within
+	// the step the ball grips at once, at the rolling velocity
+	// v - 2/7 * u, and rolls on, losing roll * dt of speed a step with its
+	// spin in step. side spin loses spin * dt of rim speed a step.
+	// a ball moves while any component of v or r is above STOP_SPEED; a
+	// stopped one loses its spin too. the kernels below keep the same
+	// operations in the same order, so they give the scalar bits
+	static const Real TWO_SEVENTHS = (Real)(2.0 / 7);
+
+	struct RigidStep {
+		Real    scale;      // TIME_SCALE * dt
+		Real    slide;      // velocity a sliding ball loses in the step
+		Real    grip;       // slip below which the ball grips within the step
+		Real    roll;       // speed a rolling ball loses in the step
+		Real    spin;       // rim speed side spin loses in the step
+
+		RigidStep(Real dt, const BallPhysics& p)
+			: scale(TIME_SCALE * dt), slide(p.slide * dt), grip((Real)3.5 * p.slide * dt),
+			roll(p.roll * dt), spin(p.spin * dt) {}
+	};
+
+#if defined(SIM_AVX)
+	void integrateRigid(BallStore& balls, Real timeDiff, const BallPhysics& physics, const Extent& limits,
+		const int* blocks, int blockCount)
+	{
+		const RigidStep s(timeDiff, physics);
+		const __m256 sign = _mm256_set1_ps(-0.0f), zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+		const __m256 stop = _mm256_set1_ps(STOP_SPEED);
+		const __m256 scale = _mm256_set1_ps(s.scale), slide = _mm256_set1_ps(s.slide), grip = _mm256_set1_ps(s.grip);
+		const __m256 roll = _mm256_set1_ps(s.roll), spin = _mm256_set1_ps(s.spin);
+		const __m256 twoSevenths = _mm256_set1_ps(TWO_SEVENTHS), fiveHalves = _mm256_set1_ps(2.5f);
+		const __m256 maxX = _mm256_set1_ps(limits.maxX), minX = _mm256_set1_ps(limits.minX);
+		const __m256 maxZ = _mm256_set1_ps(limits.maxZ), minZ = _mm256_set1_ps(limits.minZ);
+		float *px = &balls.x[0], *pz = &balls.z[0], *pvx = &balls.vx[0], *pvz = &balls.vz[0];
+		float *prx = &balls.rx[0], *prz = &balls.rz[0], *pw = &balls.w[0];
+
+		for (int k = 0; k < blockCount; k++) {
+			int i = (blocks ? blocks[k] : k) * BallStore::LANES;
+			__m256 x = _mm256_loadu_ps(px + i), z = _mm256_loadu_ps(pz + i);
+			__m256 vx = _mm256_loadu_ps(pvx + i), vz = _mm256_loadu_ps(pvz + i);
+			__m256 rx = _mm256_loadu_ps(prx + i), rz = _mm256_loadu_ps(prz + i);
+			__m256 w = _mm256_loadu_ps(pw + i);
+
+			__m256 moving = _mm256_or_ps(
+				_mm256_or_ps(_mm256_cmp_ps(_mm256_andnot_ps(sign, vx), stop, _CMP_GT_OQ),
+					_mm256_cmp_ps(_mm256_andnot_ps(sign, vz), stop, _CMP_GT_OQ)),
+				_mm256_or_ps(_mm256_cmp_ps(_mm256_andnot_ps(sign, rx), stop, _CMP_GT_OQ),
+					_mm256_cmp_ps(_mm256_andnot_ps(sign, rz), stop, _CMP_GT_OQ)));
+			__m256 tx = _mm256_add_ps(x, _mm256_mul_ps(scale, vx));
+			__m256 tz = _mm256_add_ps(z, _mm256_mul_ps(scale, vz));
+			tx = _mm256_max_ps(_mm256_min_ps(tx, maxX), minX);
+			tz = _mm256_max_ps(_mm256_min_ps(tz, maxZ), minZ);
+
+			// sliding
+			__m256 ux = _mm256_sub_ps(vx, rx), uz = _mm256_sub_ps(vz, rz);
+			__m256 slip = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(ux, ux), _mm256_mul_ps(uz, uz)));
+			__m256 sliding = _mm256_cmp_ps(slip, grip, _CMP_GT_OQ);
+			__m256 kv = _mm256_div_ps(slide, slip), kr = _mm256_mul_ps(kv, fiveHalves);
+			__m256 svx = _mm256_sub_ps(vx, _mm256_mul_ps(kv, ux)), svz = _mm256_sub_ps(vz, _mm256_mul_ps(kv, uz));
+			__m256 srx = _mm256_add_ps(rx, _mm256_mul_ps(kr, ux)), srz = _mm256_add_ps(rz, _mm256_mul_ps(kr, uz));
+
+			// rolling
+			__m256 gvx = _mm256_sub_ps(vx, _mm256_mul_ps(ux, twoSevenths));
+			__m256 gvz = _mm256_sub_ps(vz, _mm256_mul_ps(uz, twoSevenths));
+			__m256 speed = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gvx, gvx), _mm256_mul_ps(gvz, gvz)));
+			__m256 f = _mm256_and_ps(_mm256_cmp_ps(speed, roll, _CMP_GT_OQ), _mm256_sub_ps(one, _mm256_div_ps(roll, speed)));
+			gvx = _mm256_mul_ps(gvx, f);
+			gvz = _mm256_mul_ps(gvz, f);
+
+			__m256 sw = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(w, spin), zero), _mm256_min_ps(_mm256_add_ps(w, spin), zero));
+
+			_mm256_storeu_ps(px + i, _mm256_blendv_ps(x, tx, moving));
+			_mm256_storeu_ps(pz + i, _mm256_blendv_ps(z, tz, moving));
+			_mm256_storeu_ps(pvx + i, _mm256_and_ps(_mm256_blendv_ps(gvx, svx, sliding), moving));
+			_mm256_storeu_ps(pvz + i, _mm256_and_ps(_mm256_blendv_ps(gvz, svz, sliding), moving));
+			_mm256_storeu_ps(prx + i, _mm256_and_ps(_mm256_blendv_ps(gvx, srx, sliding), moving));
+			_mm256_storeu_ps(prz + i, _mm256_and_ps(_mm256_blendv_ps(gvz, srz, sliding), moving));
+			_mm256_storeu_ps(pw + i, _mm256_and_ps(sw, moving));
+		}
+	}
+#elif defined(SIM_SSE2)
+	static inline __m128 select(__m128 mask, __m128 a, __m128 b)     // mask ? a : b
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	void integrateRigid(BallStore& balls, Real timeDiff, const BallPhysics& physics, const Extent& limits,
+		const int* blocks, int blockCount)
+	{
+		const RigidStep s(timeDiff, physics);
+		const __m128 sign = _mm_set1_ps(-0.0f), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		const __m128 stop = _mm_set1_ps(STOP_SPEED);
+		const __m128 scale = _mm_set1_ps(s.scale), slide = _mm_set1_ps(s.slide), grip = _mm_set1_ps(s.grip);
+		const __m128 roll = _mm_set1_ps(s.roll), spin = _mm_set1_ps(s.spin);
+		const __m128 twoSevenths = _mm_set1_ps(TWO_SEVENTHS), fiveHalves = _mm_set1_ps(2.5f);
+		const __m128 maxX = _mm_set1_ps(limits.maxX), minX = _mm_set1_ps(limits.minX);
+		const __m128 maxZ = _mm_set1_ps(limits.maxZ), minZ = _mm_set1_ps(limits.minZ);
+		float *px = &balls.x[0], *pz = &balls.z[0], *pvx = &balls.vx[0], *pvz = &balls.vz[0];
+		float *prx = &balls.rx[0], *prz = &balls.rz[0], *pw = &balls.w[0];
+
+		for (int k = 0; k < blockCount; k++) {
+			int first = (blocks ? blocks[k] : k) * BallStore::LANES;
+			for (int i = first; i < first + BallStore::LANES; i += 4) {
+				__m128 x = _mm_loadu_ps(px + i), z = _mm_loadu_ps(pz + i);
+				__m128 vx = _mm_loadu_ps(pvx + i), vz = _mm_loadu_ps(pvz + i);
+				__m128 rx = _mm_loadu_ps(prx + i), rz = _mm_loadu_ps(prz + i);
+				__m128 w = _mm_loadu_ps(pw + i);
+
+				__m128 moving = _mm_or_ps(
+					_mm_or_ps(_mm_cmpgt_ps(_mm_andnot_ps(sign, vx), stop), _mm_cmpgt_ps(_mm_andnot_ps(sign, vz), stop)),
+					_mm_or_ps(_mm_cmpgt_ps(_mm_andnot_ps(sign, rx), stop), _mm_cmpgt_ps(_mm_andnot_ps(sign, rz), stop)));
+				__m128 tx = _mm_add_ps(x, _mm_mul_ps(scale, vx));
+				__m128 tz = _mm_add_ps(z, _mm_mul_ps(scale, vz));
+				tx = _mm_max_ps(_mm_min_ps(tx, maxX), minX);
+				tz = _mm_max_ps(_mm_min_ps(tz, maxZ), minZ);
+
+				// sliding
+				__m128 ux = _mm_sub_ps(vx, rx), uz = _mm_sub_ps(vz, rz);
+				__m128 slip = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ux, ux), _mm_mul_ps(uz, uz)));
+				__m128 sliding = _mm_cmpgt_ps(slip, grip);
+				__m128 kv = _mm_div_ps(slide, slip), kr = _mm_mul_ps(kv, fiveHalves);
+				__m128 svx = _mm_sub_ps(vx, _mm_mul_ps(kv, ux)), svz = _mm_sub_ps(vz, _mm_mul_ps(kv, uz));
+				__m128 srx = _mm_add_ps(rx, _mm_mul_ps(kr, ux)), srz = _mm_add_ps(rz, _mm_mul_ps(kr, uz));
+
+				// rolling
+				__m128 gvx = _mm_sub_ps(vx, _mm_mul_ps(ux, twoSevenths));
+				__m128 gvz = _mm_sub_ps(vz, _mm_mul_ps(uz, twoSevenths));
+				__m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gvx, gvx), _mm_mul_ps(gvz, gvz)));
+				__m128 f = _mm_and_ps(_mm_cmpgt_ps(speed, roll), _mm_sub_ps(one, _mm_div_ps(roll, speed)));
+				gvx = _mm_mul_ps(gvx, f);
+				gvz = _mm_mul_ps(gvz, f);
+
+				__m128 sw = _mm_add_ps(_mm_max_ps(_mm_sub_ps(w, spin), zero), _mm_min_ps(_mm_add_ps(w, spin), zero));
+
+				_mm_storeu_ps(px + i, select(moving, tx, x));
+				_mm_storeu_ps(pz + i, select(moving, tz, z));
+				_mm_storeu_ps(pvx + i, _mm_and_ps(select(sliding, svx, gvx), moving));
+				_mm_storeu_ps(pvz + i, _mm_and_ps(select(sliding, svz, gvz), moving));
+				_mm_storeu_ps(prx + i, _mm_and_ps(select(sliding, srx, gvx), moving));
+				_mm_storeu_ps(prz + i, _mm_and_ps(select(sliding, srz, gvz), moving));
+				_mm_storeu_ps(pw + i, _mm_and_ps(sw, moving));
+			}
+		}
+	}
+#else
+	void integrateRigid(BallStore& balls, Real timeDiff, const BallPhysics& physics, const Extent& limits,
+		const int* blocks, int blockCount)
+	{
+		const RigidStep s(timeDiff, physics);
+
+		for (int k = 0; k < blockCount; k++) {
+			int first = (blocks ? blocks[k] : k) * BallStore::LANES;
+			for (int i = first; i < first + BallStore::LANES; i++) {
+				Real vx = balls.vx[i], vz = balls.vz[i], rx = balls.rx[i], rz = balls.rz[i];
+				if (std::fabs(vx) <= STOP_SPEED && std::fabs(vz) <= STOP_SPEED
+					&& std::fabs(rx) <= STOP_SPEED && std::fabs(rz) <= STOP_SPEED) {
+					balls.vx[i] = balls.vz[i] = 0;
+					balls.rx[i] = balls.rz[i] = 0;
+					balls.w[i] = 0;
+					continue;
+				}
+				balls.x[i] = std::max(limits.minX, std::min(balls.x[i] + s.scale * vx, limits.maxX));
+				balls.z[i] = std::max(limits.minZ, std::min(balls.z[i] + s.scale * vz, limits.maxZ));
+
+				Real ux = vx - rx, uz = vz - rz;
+				Real slip = std::sqrt(ux * ux + uz * uz);
+				if (slip > s.grip) {
+					Real kv = s.slide / slip, kr = kv * (Real)2.5;
+					balls.vx[i] = vx - kv * ux;
+					balls.vz[i] = vz - kv * uz;
+					balls.rx[i] = rx + kr * ux;
+					balls.rz[i] = rz + kr * uz;
+				}
+				else {
+					vx = vx - ux * TWO_SEVENTHS;
+					vz = vz - uz * TWO_SEVENTHS;
+					Real speed = std::sqrt(vx * vx + vz * vz);
+					Real f = speed > s.roll ? 1 - s.roll / speed : 0;
+					balls.vx[i] = balls.rx[i] = vx * f;
+					balls.vz[i] = balls.rz[i] = vz * f;
+				}
+				Real w = balls.w[i];
+				balls.w[i] = std::max(w - s.spin, (Real)0) + std::min(w + s.spin, (Real)0);
+			}
+		}
+	}
+#endif
+
+	void integrateRigid(BallStore& balls, Real timeDiff, const BallPhysics& physics, const Extent& limits)
+	{
+		integrateRigid(balls, timeDiff, physics, limits, NULL, balls.paddedSize() / BallStore::LANES);
+	}
+
+	// -------------------------------------------------------------------------
+	// cue launch
+	// -------------------------------------------------------------------------
+
+	// power / |direction| scales the direction straight to the launch
+	// velocity, with no angle in between. the kernels below keep the same
+	// operations in the same order, so bulk and single launches agree
+	Vec2 launchVelocity(const CueStroke& stroke)
+	{
+		Real len = std::sqrt(stroke.direction.x * stroke.direction.x + stroke.direction.z * stroke.direction.z);
+		if (len == 0)
+			return Vec2();
+		Real k = stroke.power / len;
+		return Vec2(stroke.direction.x * k, stroke.direction.z * k);
+	}
+
+#if defined(SIM_AVX)
+	static int launchLanes(const float* dirX, const float* dirZ, const float* power, int count, float* vx, float* vz)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256 dx = _mm256_loadu_ps(dirX + i), dz = _mm256_loadu_ps(dirZ + i);
+			__m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dz, dz)));
+			__m256 k = _mm256_div_ps(_mm256_loadu_ps(power + i), len);
+			__m256 valid = _mm256_cmp_ps(len, zero, _CMP_NEQ_OQ);
+			_mm256_storeu_ps(vx + i, _mm256_and_ps(_mm256_mul_ps(dx, k), valid));
+			_mm256_storeu_ps(vz + i, _mm256_and_ps(_mm256_mul_ps(dz, k), valid));
+		}
+		return i;
+	}
+#elif defined(SIM_SSE2)
+	static int launchLanes(const float* dirX, const float* dirZ, const float* power, int count, float* vx, float* vz)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128 dx = _mm_loadu_ps(dirX + i), dz = _mm_loadu_ps(dirZ + i);
+			__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)));
+			__m128 k = _mm_div_ps(_mm_loadu_ps(power + i), len);
+			__m128 valid = _mm_cmpneq_ps(len, zero);
+			_mm_storeu_ps(vx + i, _mm_and_ps(_mm_mul_ps(dx, k), valid));
+			_mm_storeu_ps(vz + i, _mm_and_ps(_mm_mul_ps(dz, k), valid));
+		}
+		return i;
+	}
+#else
+	static int launchLanes(const Real*, const Real*, const Real*, int, Real*, Real*)
+	{
+		return 0;
+	}
+#endif
+
+	void launchVelocities(const Real* dirX, const Real* dirZ, const Real* power, int count,
+		Real* vx, Real* vz)
+	{
+		for (int i = launchLanes(dirX, dirZ, power, count, vx, vz); i < count; i++) {
+			Vec2 v = launchVelocity(CueStroke(Vec2(dirX[i], dirZ[i]), power[i]));
+			vx[i] = v.x;
+			vz[i] = v.z;
+		}
+	}
+
+	// -------------------------------------------------------------------------
+	// World
+	// -------------------------------------------------------------------------
+
+	World::World(void)
+	{
+		m_pairsTested = 0;
+		m_radius = (Real)M_RADIUS;
+		m_damping = DAMPING;
+		m_model = DAMPED;
+		m_solver = FIXED_STEP;
+		m_fixedStep = 0;
+		m_accumulator = 0;
+		m_stepIndex = 0;
+		m_shotTime = 0;
+	}
+
+	void World::reset(const float pos[][2], int count)
+	{
+		m_balls.resize(count);
+		m_active.clear();
+		m_activeSlot.assign(count, -1);
+		m_touched.assign(count, 0);
+		m_blockMarked.assign(m_balls.paddedSize() / BallStore::LANES, 0);
+		// every ball starts awake, so balls placed overlapping are pushed
+		// apart before they fall asleep
+		for (int i = 0; i < count; i++) {
+			setCenter(i, pos[i][0], pos[i][1]);
+			setPower(i, 0, 0);
+		}
+		clearContacts();
+
+		// size the per-step buffers up front so that stepping the table does
+		// not allocate in the common case. a hard shot on a small table bounces
+		// off the cushions a few dozen times before it stops
+		m_contacts.reserve(4 * count + 64);
+		m_broadPhase.reserve(count);
+		m_active.reserve(count);
+		m_blocks.reserve(m_blockMarked.size());
+	}
+
+	void World::strike(int i, const CueStroke& stroke)
+	{
+		Vec2 v = launchVelocity(stroke);
+		setPower(i, v.x, v.z);
+		if (m_model != RIGID)
+			return;
+		// a tip top radii above the center gives the ball the spin of
+		// rolling at 5/2 * top times its speed; side radii beside it, a rim
+		// speed of 5/2 * side times its speed
+		Real top = (Real)2.5 * stroke.top;
+		m_balls.rx[i] = v.x * top;
+		m_balls.rz[i] = v.z * top;
+		m_balls.w[i] = (Real)2.5 * stroke.side * std::fabs(stroke.power);
+	}
+
+	void World::setModel(Model model, const BallPhysics& physics)
+	{
+		m_model = model;
+		m_physics = physics;
+		std::fill(m_balls.rx.begin(), m_balls.rx.end(), (Real)0);
+		std::fill(m_balls.rz.begin(), m_balls.rz.end(), (Real)0);
+		std::fill(m_balls.w.begin(), m_balls.w.end(), (Real)0);
+		if (model == RIGID)
+			m_cushions.setResponse(physics.restitution, physics.cushionFriction);
+		else
+			m_cushions.setResponse(1, 0);
+	}
+
+	void World::swapBalls(int i, int j)
+	{
+		std::swap(m_balls.x[i], m_balls.x[j]);
+		std::swap(m_balls.z[i], m_balls.z[j]);
+		std::swap(m_balls.vx[i], m_balls.vx[j]);
+		std::swap(m_balls.vz[i], m_balls.vz[j]);
+		std::swap(m_balls.rx[i], m_balls.rx[j]);
+		std::swap(m_balls.rz[i], m_balls.rz[j]);
+		std::swap(m_balls.w[i], m_balls.w[j]);
+		wake(i);
+		wake(j);
+	}
+
+	void World::wake(int i)
+	{
+		if (m_activeSlot[i] >= 0)
+			return;
+		m_activeSlot[i] = (int)m_active.size();
+		m_active.push_back(i);
+	}
+
+	void World::sleep(int i)
+	{
+		int slot = m_activeSlot[i];
+		if (slot < 0)
+			return;
+		int last = m_active.back();
+		m_active[slot] = last;
+		m_activeSlot[last] = slot;
+		m_active.pop_back();
+		m_activeSlot[i] = -1;
+	}
+
+	// blocks of the integration kernel that hold an awake ball
+	void World::activeBlocks(void)
+	{
+		m_blocks.clear();
+		for (size_t k = 0; k < m_active.size(); k++) {
+			int b = m_active[k] / BallStore::LANES;
+			if (!m_blockMarked[b]) {
+				m_blockMarked[b] = 1;
+				m_blocks.push_back(b);
+			}
+		}
+		for (size_t k = 0; k < m_blocks.size(); k++)
+			m_blockMarked[m_blocks[k]] = 0;
+	}
+
+	// overlap test of the narrow phase. overlapping balls are pushed apart a little
+	bool World::hasIntersected(int i, int j)
+	{
+		const Real nudge = getRadius() / 100;
+		Real *x = &m_balls.x[0], *z = &m_balls.z[0];
+		Real dx = x[i] - x[j], dz = z[i] - z[j];
+		Real reach = 2 * getRadius();
+		if (dx * dx + dz * dz <= reach * reach)
+		{
+			if (x[i] >= x[j] && z[i] >= z[j]) {
+				x[i] += nudge;   z[i] += nudge;
+				x[j] -= nudge;   z[j] -= nudge;
+			}
+			if (x[i] >= x[j] && z[i] <= z[j]) {
+				x[i] += nudge;   z[i] -= nudge;
+				x[j] -= nudge;   z[j] += nudge;
+			}
+			if (x[i] <= x[j] && z[i] >= z[j]) {
+				x[i] -= nudge;   z[i] += nudge;
+				x[j] += nudge;   z[j] -= nudge;
+			}
+			if (x[i] <= x[j] && z[i] <= z[j]) {
+				x[i] -= nudge;   z[i] -= nudge;
+				x[j] += nudge;   z[j] += nudge;
+			}
+			return true;
+		}
+		else
+			return false;
+	}
+
+	// collision response of two balls already known to touch.
+	// velocities are split into the part along the line of centers (d) and
+	// the part across it (n); the balls swap their d parts.
+	// works on values only, so resolving a contact never touches the heap
+	void World::hitBy(int i, int j)
+	{
+		Vec2 colVec = getCenter(j) - getCenter(i);
+		Vec2 myVec = getVelocity(i);
+		Vec2 ballVec = getVelocity(j);
+
+		Real colLenSq = dot(colVec, colVec);
+		if (colLenSq == 0)
+			return;
+
+		Real inv = 1 / colLenSq;
+		Vec2 d1 = colVec * (dot(colVec, myVec) * inv);
+		Vec2 d2 = colVec * (dot(colVec, ballVec) * inv);
+		Vec2 n1 = myVec - d1;         // d1 + n1 = myVec
+		Vec2 n2 = ballVec - d2;       // d2 + n2 = ballVec
+
+		setPower(i, d2.x + n1.x, d2.z + n1.z);
+		setPower(j, d1.x + n2.x, d1.z + n2.z);
+	}
+
+	void World::step(float dt)
+	{
+		// after a stall, drop the backlog instead of trying to catch up with it
+		const int MAX_STEPS_PER_CALL = 64;
+
+		if (m_fixedStep <= 0) {
+			advance(dt);
+			return;
+		}
+
+		m_accumulator += dt;
+		for (int k = 0; m_accumulator >= m_fixedStep; k++) {
+			if (k == MAX_STEPS_PER_CALL) {
+				m_accumulator = 0;
+				break;
+			}
+			tick();
+			m_accumulator -= m_fixedStep;
+		}
+	}
+
+	void World::tick(void)
+	{
+		advance(m_fixedStep);
+		m_stepIndex++;
+	}
+
+	void World::advance(Real dt)
+	{
+		PROFILE_COUNT("steps", 1);
+		m_cushions.build(getRadius());
+		m_pairsTested = 0;
+		if (m_solver == EVENT_DRIVEN && m_model == DAMPED) {
+			EventSolver::advance(*this, dt);
+			PROFILE_COUNT("pairs tested", m_pairsTested);
+			return;
+		}
+		stepBalls(dt);
+	}
+
+	// dt in fixed steps: one for a damped world, as many as keep every ball
+	// within half a radius a step for a rigid one. returns the steps taken
+	int World::stepBalls(Real dt)
+	{
+		// a rigid shot is cut into no more steps than this per call
+		const int MAX_SUBSTEPS = 64;
+
+		// a table at rest costs nothing
+		if (m_active.empty())
+			return 0;
+
+		int steps = 1;
+		if (m_model == RIGID) {
+			// |vx| + |vz| is no less than the speed, and a ball never gets
+			// faster than the larger of its velocity and its rolling velocity
+			Real fastest = 0;
+			for (size_t k = 0; k < m_active.size(); k++) {
+				int i = m_active[k];
+				fastest = std::max(fastest, std::max(std::fabs(m_balls.vx[i]) + std::fabs(m_balls.vz[i]),
+					std::fabs(m_balls.rx[i]) + std::fabs(m_balls.rz[i])));
+			}
+			Real cut = std::ceil(fastest * TIME_SCALE * dt * 2 / getRadius());
+			steps = cut < 1 ? 1 : cut > MAX_SUBSTEPS ? MAX_SUBSTEPS : (int)cut;
+		}
+		for (int s = 0; s < steps && !m_active.empty(); s++)
+			stepOnce(dt / (Real)steps);
+		return steps;
+	}
+
+	void World::stepOnce(Real dt)
+	{
+		// contacts of this step are stamped with its end
+		m_shotTime += dt;
+
+		// update the position of each awake ball. after update, check whether each one hit a cushion.
+		// each ball only tests the cushions in its own grid cell
+		{
+			PROFILE_SCOPE("integrate");
+			activeBlocks();
+			const int* blocks = m_blocks.empty() ? NULL : &m_blocks[0];
+			if (m_model == RIGID)
+				integrateRigid(m_balls, dt, m_physics, m_cushions.limits(), blocks, (int)m_blocks.size());
+			else
+				integrate(m_balls, dt, m_damping, m_cushions.limits(), blocks, (int)m_blocks.size());
+		}
+		{
+			PROFILE_SCOPE("cushions");
+			for (size_t k = 0; k < m_active.size(); k++) {
+				int segment = m_cushions.collide(m_balls, m_active[k]);
+				if (segment >= 0)
+					addContact(ContactEvent::CUSHION, m_active[k], segment);
+			}
+		}
+
+		// check whether any two balls hit together and update the direction of balls.
+		// only pairs with an awake ball the broad phase reports can touch, and each
+		// is tested once. a sleeping ball in a contact wakes up
+		{
+			PROFILE_SCOPE("pairs");
+			const std::vector<BroadPhase::Pair>& pairs = m_broadPhase.findPairs(m_balls, 2 * getRadius(), m_active, m_activeSlot);
+			for (size_t k = 0; k < pairs.size(); k++) {
+				int i = pairs[k].i, j = pairs[k].j;
+				if (hasIntersected(i, j)) {
+					wake(i);
+					wake(j);
+					m_touched[i] = m_touched[j] = 1;
+					addContact(ContactEvent::BALL, i, j);
+					hitBy(i, j);
+				}
+			}
+			m_pairsTested += (int)pairs.size();
+			PROFILE_COUNT("pairs tested", (int)pairs.size());
+		}
+
+		// balls at rest that touched nothing fall asleep. going backwards, a
+		// removal only moves a ball that was already looked at
+		for (int k = (int)m_active.size() - 1; k >= 0; k--) {
+			int i = m_active[k];
+			if (m_touched[i])
+				m_touched[i] = 0;
+			else if (atRest(i))
+				sleep(i);
+		}
+		PROFILE_COUNT("awake", (int)m_active.size());
+	}
+
+	int World::runToRest(void)
+	{
+		return EventSolver::runToRest(*this);
+	}
+
+	// spin is zero under the damped model, so this holds for both
+	bool World::atRest(int i) const
+	{
+		return m_balls.vx[i] == 0 && m_balls.vz[i] == 0 && m_balls.rx[i] == 0 && m_balls.rz[i] == 0;
+	}
+
+	void World::addContact(ContactEvent::Type type, int a, int b)
+	{
+		if (type == ContactEvent::BALL && a > b)
+			std::swap(a, b);
+		ContactEvent e;
+		e.time = (float)m_shotTime;
+		e.type = type;
+		e.a = a;
+		e.b = b;
+		m_contacts.push_back(e);
+	}
+
+	bool World::hasContact(int i, int j) const
+	{
+		if (i > j)
+			std::swap(i, j);
+		for (size_t k = 0; k < m_contacts.size(); k++) {
+			const ContactEvent& e = m_contacts[k];
+			if (e.type == ContactEvent::BALL && e.a == i && e.b == j)
+				return true;
+		}
+		return false;
+	}
+
+	bool World::isStopped(void) const
+	{
+		for (size_t k = 0; k < m_active.size(); k++) {
+			if (!atRest(m_active[k]))
+				return false;
+		}
+		return true;
+	}
+
+	void World::clearContacts(void)
+	{
+		m_contacts.clear();
+		m_shotTime = 0;
+	}
+}
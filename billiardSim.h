@@ -0,0 +1,299 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: billiardSim.h
+//
+// Headless simulation core of Virtual Billiard.
+// Ball and cushion state/logic that used to live inside CSphere and CWall.
+// Nothing in here depends on Direct3D, so the table physics can be built and
+// run on machines without a GPU. virtualLego.cpp only draws what it finds here.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __billiardSimH__
+#define __billiardSimH__
+
+#include <vector>
+#include "broadPhase.h"
+#include "cushions.h"
+#include "real.h"
+
+#define M_RADIUS 0.21   // ball radius of the standard table
+#define DECREASE_RATE 0.9982
+
+namespace sim
+{
+	// positions move by TIME_SCALE * velocity per second
+	const Real TIME_SCALE = (Real)3.3;
+	// a ball whose velocity components are both below this is at rest
+	const Real STOP_SPEED = (Real)0.01;
+	// range of a ball center inside the rails of the standard 9 x 6 table
+	const Real BOUND_X = (Real)(4.5 - M_RADIUS);
+	const Real BOUND_Z = (Real)(3 - M_RADIUS);
+	// continuous damping rate (1/s) of the per-frame DECREASE_RATE damping,
+	// the default of World::setDamping
+	const Real DAMPING = (Real)((1 - DECREASE_RATE) * 400);
+
+	// -------------------------------------------------------------------------
+	// Vec2 : a point or a direction on the table plane (x, z)
+	// -------------------------------------------------------------------------
+
+	struct Vec2 {
+		Real x, z;
+
+		Vec2(void) : x(0), z(0) {}
+		Vec2(Real ix, Real iz) : x(ix), z(iz) {}
+
+		Vec2 operator+(const Vec2& v) const { return Vec2(x + v.x, z + v.z); }
+		Vec2 operator-(const Vec2& v) const { return Vec2(x - v.x, z - v.z); }
+		Vec2 operator-(void) const { return Vec2(-x, -z); }
+		Vec2 operator*(Real s) const { return Vec2(x * s, z * s); }
+		Vec2 operator/(Real s) const { return Vec2(x / s, z / s); }
+		Vec2& operator+=(const Vec2& v) { x += v.x; z += v.z; return *this; }
+		Vec2& operator-=(const Vec2& v) { x -= v.x; z -= v.z; return *this; }
+		Vec2& operator*=(Real s) { x *= s; z *= s; return *this; }
+	};
+
+	inline Real dot(const Vec2& a, const Vec2& b) { return a.x * b.x + a.z * b.z; }
+
+	// -------------------------------------------------------------------------
+	// CueStroke : how the cue strikes a ball
+	// -------------------------------------------------------------------------
+
+	// the ball leaves along direction (any length but zero) with speed
+	// power. side and top are where the tip meets the ball, in radii off its
+	// center: top above it for follow, below for draw, side toward
+	// (-direction.z, direction.x) for english. only the rigid-ball model
+	// (World::RIGID) spins balls; the damped one ignores side and top
+	struct CueStroke {
+		Vec2            direction;
+		Real            power;
+		Real            side, top;
+
+		CueStroke(void) : power(0), side(0), top(0) {}
+		CueStroke(const Vec2& dir, Real ipower, Real iside = 0, Real itop = 0)
+			: direction(dir), power(ipower), side(iside), top(itop) {}
+	};
+
+	// velocity a stroke gives the ball: direction scaled to length power.
+	// zero for a zero direction
+	Vec2 launchVelocity(const CueStroke& stroke);
+	// the same for count strokes given as arrays, for launching candidate
+	// shots in bulk. uses AVX or SSE2 when the compiler targets them, and
+	// gives the same bits as launchVelocity()
+	void launchVelocities(const Real* dirX, const Real* dirZ, const Real* power, int count,
+		Real* vx, Real* vz);
+
+	// -------------------------------------------------------------------------
+	// BallPhysics : parameters of the rigid-ball model (World::RIGID)
+	// -------------------------------------------------------------------------
+
+	// rates are in velocity units per second; a ball at velocity v covers
+	// TIME_SCALE * v per second
+	struct BallPhysics {
+		Real            slide;          // deceleration of a ball sliding on the cloth
+		Real            roll;           // deceleration of a rolling ball
+		Real            spin;           // slow-down of side spin
+		Real            restitution;    // share of its speed into a cushion a ball keeps
+		Real            cushionFriction; // how much side spin bends a rebound, and a rebound spins a ball
+
+		BallPhysics(void) : slide(6), roll((Real)0.6), spin((Real)1.2), restitution((Real)0.85), cushionFriction((Real)0.2) {}
+	};
+
+	// -------------------------------------------------------------------------
+	// BallStore : structure-of-arrays state of every ball on the table
+	// -------------------------------------------------------------------------
+
+	// arrays are padded to a multiple of LANES with balls at rest at the origin,
+	// so the integration kernel never needs a scalar tail loop.
+	class BallStore {
+	public:
+		enum { LANES = 8 };
+
+		BallStore(void) : m_count(0) {}
+
+		void resize(int count);
+		int size(void) const { return m_count; }
+		int paddedSize(void) const { return (int)x.size(); }
+
+		std::vector<Real>   x, z;       // center on the table plane
+		std::vector<Real>   vx, vz;     // velocity
+
+		// spin, rigid-ball model only; zero under the damped one.
+		// (rx, rz) is the velocity the ball would roll at with its spin
+		// about the horizontal axes: equal to (vx, vz) while it rolls, ahead
+		// of it for follow and behind it for draw. w is the side spin about
+		// the vertical, as the speed of the ball's rim
+		std::vector<Real>   rx, rz;
+		std::vector<Real>   w;
+
+	private:
+		int                 m_count;
+	};
+
+	// advance every ball of the store by timeDiff and damp it at the rate
+	// damping (1/s) in one pass, keeping moving balls within limits. uses
+	// AVX or SSE2 when the compiler targets them and Real is float.
+	void integrate(BallStore& balls, Real timeDiff, Real damping, const Extent& limits);
+	// the same for only the given blocks of LANES balls (block b holds
+	// balls b * LANES to b * LANES + LANES - 1)
+	void integrate(BallStore& balls, Real timeDiff, Real damping, const Extent& limits, const int* blocks, int blockCount);
+
+	// advance every ball of the store by timeDiff under the rigid-ball
+	// model, in one pass: a sliding ball is slowed and its spin turned by
+	// the cloth until it rolls, a rolling one slows down, side spin fades.
+	// limits and SIMD as for integrate()
+	void integrateRigid(BallStore& balls, Real timeDiff, const BallPhysics& physics, const Extent& limits);
+	void integrateRigid(BallStore& balls, Real timeDiff, const BallPhysics& physics, const Extent& limits,
+		const int* blocks, int blockCount);
+
+	// -------------------------------------------------------------------------
+	// ContactEvent : one touch during a shot, as the physics records it
+	// -------------------------------------------------------------------------
+
+	struct ContactEvent {
+		enum Type { BALL, CUSHION };
+
+		float           time;       // seconds since World::clearContacts()
+		Type            type;
+		int             a, b;       // balls a < b, or ball a and cushion segment b
+	};
+
+	// -------------------------------------------------------------------------
+	// World : every ball and cushion on the table, advanced by step(dt)
+	// -------------------------------------------------------------------------
+
+	class World {
+	public:
+		// FIXED_STEP integrates and then resolves overlaps once per step().
+		// EVENT_DRIVEN hands step() to EventSolver, which finds the exact
+		// time of every impact in between (see eventSolver.h)
+		enum Solver { FIXED_STEP, EVENT_DRIVEN };
+
+		// DAMPED balls slow down at the damping rate and cushions reflect
+		// them. RIGID balls spin, slide and roll on the cloth, and leave the
+		// cushions with restitution and friction (see BallPhysics). its paths
+		// curve while balls slide, which the event solver cannot follow, so
+		// a RIGID world always takes fixed steps, short enough that no ball
+		// moves more than half a radius in one
+		enum Model { DAMPED, RIGID };
+
+		World(void);
+
+		// remove all balls and place count balls at pos[i] (x, z), at rest
+		void reset(const float pos[][2], int count);
+
+		int ballCount(void) const { return m_balls.size(); }
+		BallStore& balls(void) { return m_balls; }
+		const BallStore& balls(void) const { return m_balls; }
+		Vec2 getCenter(int i) const { return Vec2(m_balls.x[i], m_balls.z[i]); }
+		Vec2 getVelocity(int i) const { return Vec2(m_balls.vx[i], m_balls.vz[i]); }
+		void setCenter(int i, Real x, Real z) { m_balls.x[i] = x;   m_balls.z[i] = z;   wake(i); }
+		void setPower(int i, Real vx, Real vz) { m_balls.vx[i] = vx;   m_balls.vz[i] = vz;   wake(i); }
+		// a cue stroke on ball i. spins it under the rigid-ball model
+		void strike(int i, const CueStroke& stroke);
+		Real getRadius(void) const { return m_radius; }
+
+		// physics of the table: the radius of every ball and the rate (1/s)
+		// they slow down at. M_RADIUS and DAMPING unless a scene (scene.h)
+		// sets others. rebuilds nothing by itself; the cushions follow a new
+		// radius at the next step
+		void setRadius(Real radius) { m_radius = radius; }
+		Real getDamping(void) const { return m_damping; }
+		void setDamping(Real damping) { m_damping = damping; }
+
+		// ball model, DAMPED unless set. setting it keeps the balls where
+		// they are and stops their spin
+		void setModel(Model model, const BallPhysics& physics = BallPhysics());
+		Model getModel(void) const { return m_model; }
+		const BallPhysics& getPhysics(void) const { return m_physics; }
+
+		// cushion layout of the table. reset() leaves it as it is
+		Cushions& cushions(void) { return m_cushions; }
+		const Cushions& cushions(void) const { return m_cushions; }
+		void swapBalls(int i, int j);
+
+		// activation. a ball at rest that touched nothing during a step falls
+		// asleep: it is not integrated, tested against the cushions or swept
+		// for pairs until a contact, setPower or setCenter wakes it again.
+		// a ball changed through balls() must be woken by hand
+		void wake(int i);
+		bool isAwake(int i) const { return m_activeSlot[i] >= 0; }
+		int awakeCount(void) const { return (int)m_active.size(); }
+
+		// advance the table by dt seconds: move balls, then resolve cushion
+		// and ball-ball contacts. contacts are remembered until clearContacts().
+		// with a fixed step set, dt only feeds an accumulator and the table
+		// advances in whole steps of that size (see setFixedStep)
+		void step(float dt);
+		// advance by exactly one fixed step
+		void tick(void);
+		// advance until every ball is at rest, event by event (or step by
+		// step under the rigid-ball model). returns the events or steps
+		int runToRest(void);
+
+		void setSolver(Solver solver) { m_solver = solver; }
+		Solver getSolver(void) const { return m_solver; }
+
+		// fixed-timestep mode. the physics then only ever sees steps of h
+		// seconds, so the same inputs at the same step indices give the same
+		// table bit for bit, however the frames are timed. 0 turns it off
+		void setFixedStep(float h) { m_fixedStep = h;   m_accumulator = 0; }
+		float getFixedStep(void) const { return m_fixedStep; }
+		// fixed steps taken since the world was created. reset() keeps counting
+		unsigned int stepIndex(void) const { return m_stepIndex; }
+
+		// true when no awake ball moves or spins on the cloth. costs one
+		// test per awake ball
+		bool isStopped(void) const;
+
+		// every ball-ball impact and cushion bounce since clearContacts(), in
+		// the order they happened. the rules of a game (rules.h) judge a shot
+		// from these alone. the stream grows until it is cleared, so whoever
+		// steps a world for long clears it between shots
+		const std::vector<ContactEvent>& contacts(void) const { return m_contacts; }
+		// balls i and j touched since clearContacts(). one pass over contacts()
+		bool hasContact(int i, int j) const;
+		void clearContacts(void);
+
+		// ball pairs tested for a collision during the last step: broad-phase
+		// candidates, or impact-time tests of the event solver
+		int pairsTested(void) const { return m_pairsTested; }
+
+		// collision response of balls i and j, which must already touch
+		void hitBy(int i, int j);
+
+	private:
+		friend class EventSolver;
+
+		void advance(Real dt);
+		int stepBalls(Real dt);
+		void stepOnce(Real dt);
+		bool atRest(int i) const;
+		void sleep(int i);
+		void activeBlocks(void);
+		bool hasIntersected(int i, int j);
+		void addContact(ContactEvent::Type type, int a, int b);
+
+		BallStore                       m_balls;
+		Cushions                        m_cushions;
+		BroadPhase                      m_broadPhase;
+		std::vector<int>                m_active;        // awake balls
+		std::vector<int>                m_activeSlot;    // index of each ball in m_active, -1 asleep
+		std::vector<unsigned char>      m_touched;       // awake balls in a contact this step
+		std::vector<int>                m_blocks;        // blocks of LANES balls holding an awake one
+		std::vector<unsigned char>      m_blockMarked;
+		std::vector<ContactEvent>       m_contacts;
+		double                          m_shotTime;      // seconds since clearContacts()
+		int                             m_pairsTested;
+		Real                            m_radius;
+		Real                            m_damping;
+		Model                           m_model;
+		BallPhysics                     m_physics;
+		Solver                          m_solver;
+		float                           m_fixedStep;
+		float                           m_accumulator;
+		unsigned int                    m_stepIndex;
+	};
+}
+
+#endif // __billiardSimH__
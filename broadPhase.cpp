@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: broadPhase.cpp
+//
+// Sort-and-sweep broad phase for ball-ball collision. See broadPhase.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "broadPhase.h"
+#include "billiardSim.h"
+#include <cmath>
+#include <algorithm>
+
+namespace sim
+{
+	struct LessX {
+		const Real* x;
+		bool operator()(int a, int b) const { return x[a] < x[b]; }
+	};
+
+	// insertion sort on the order of the last frame. balls move a little per
+	// frame, so this is nearly linear; a full sort is only done on resize.
+	void BroadPhase::sortByX(const BallStore& balls)
+	{
+		const Real* x = &balls.x[0];
+		int n = balls.size();
+		int a, b;
+
+		if ((int)m_order.size() != n) {
+			LessX less = { x };
+			m_order.resize(n);
+			for (a = 0; a < n; a++)
+				m_order[a] = a;
+			std::sort(m_order.begin(), m_order.end(), less);
+		}
+		else {
+			for (a = 1; a < n; a++) {
+				int key = m_order[a];
+				for (b = a - 1; b >= 0 && x[m_order[b]] > x[key]; b--)
+					m_order[b + 1] = m_order[b];
+				m_order[b + 1] = key;
+			}
+		}
+
+		m_rank.resize(n);
+		for (a = 0; a < n; a++)
+			m_rank[m_order[a]] = a;
+	}
+
+	// move the active balls back into x order. the other balls kept their
+	// order, so once no active ball is out of place next to its neighbours
+	// the whole order is sorted again
+	void BroadPhase::restoreOrder(const Real* x, const std::vector<int>& active)
+	{
+		int n = (int)m_order.size();
+		bool moved = true;
+		while (moved) {
+			moved = false;
+			for (size_t k = 0; k < active.size(); k++) {
+				int i = active[k];
+				int r = m_rank[i];
+				for (; r > 0 && x[m_order[r - 1]] > x[i]; r--, moved = true) {
+					m_order[r] = m_order[r - 1];
+					m_rank[m_order[r]] = r;
+				}
+				for (; r < n - 1 && x[m_order[r + 1]] < x[i]; r++, moved = true) {
+					m_order[r] = m_order[r + 1];
+					m_rank[m_order[r]] = r;
+				}
+				m_order[r] = i;
+				m_rank[i] = r;
+			}
+		}
+	}
+
+	void BroadPhase::reserve(int count)
+	{
+		m_order.reserve(count);
+		m_rank.reserve(count);
+		m_pairs.reserve(4 * count);
+	}
+
+	const std::vector<BroadPhase::Pair>& BroadPhase::findPairs(const BallStore& balls, Real reach)
+	{
+		const Real* x = &balls.x[0];
+		const Real* z = &balls.z[0];
+		int n = balls.size();
+
+		m_pairs.clear();
+		if (n < 2)
+			return m_pairs;
+
+		sortByX(balls);
+		for (int a = 0; a < n; a++) {
+			int i = m_order[a];
+			for (int b = a + 1; b < n && x[m_order[b]] - x[i] <= reach; b++) {
+				int j = m_order[b];
+				if (fabs(z[j] - z[i]) > reach)
+					continue;
+				Pair p;
+				p.i = std::min(i, j);
+				p.j = std::max(i, j);
+				m_pairs.push_back(p);
+			}
+		}
+		return m_pairs;
+	}
+
+	const std::vector<BroadPhase::Pair>& BroadPhase::findPairs(const BallStore& balls, Real reach,
+		const std::vector<int>& active, const std::vector<int>& activeSlot)
+	{
+		const Real* x = &balls.x[0];
+		const Real* z = &balls.z[0];
+		int n = balls.size();
+
+		m_pairs.clear();
+		if (n < 2)
+			return m_pairs;
+
+		if ((int)m_order.size() != n)
+			sortByX(balls);
+		else
+			restoreOrder(x, active);
+
+		// sweep both ways from every active ball. a pair of two active
+		// balls is reported from the lower index only
+		for (size_t k = 0; k < active.size(); k++) {
+			int i = active[k];
+			int r = m_rank[i];
+			for (int dir = -1; dir <= 1; dir += 2) {
+				for (int b = r + dir; b >= 0 && b < n && fabs(x[m_order[b]] - x[i]) <= reach; b += dir) {
+					int j = m_order[b];
+					if ((j < i && activeSlot[j] >= 0) || fabs(z[j] - z[i]) > reach)
+						continue;
+					Pair p;
+					p.i = std::min(i, j);
+					p.j = std::max(i, j);
+					m_pairs.push_back(p);
+				}
+			}
+		}
+		return m_pairs;
+	}
+}
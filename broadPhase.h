@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: broadPhase.h
+//
+// Sort-and-sweep broad phase for ball-ball collision.
+// Balls are kept sorted along x between frames, so with coherent motion the
+// re-sort is close to linear and only pairs whose bounds overlap on both x and
+// z are handed to the narrow phase.
+// When most balls sleep, only the awake ones are moved back into order and
+// swept from, so the cost follows the number of awake balls.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __broadPhaseH__
+#define __broadPhaseH__
+
+#include <vector>
+#include "real.h"
+
+namespace sim
+{
+	class BallStore;
+
+	class BroadPhase {
+	public:
+		struct Pair {
+			int i, j;   // i < j
+		};
+
+		// every pair of balls whose centers are within reach on both axes.
+		// each pair is reported once; the result is valid until the next call
+		const std::vector<Pair>& findPairs(const BallStore& balls, Real reach);
+
+		// the same, restricted to pairs with at least one ball of active.
+		// activeSlot[i] is negative for a sleeping ball. only the active
+		// balls may have moved since the last call, unless invalidate() was
+		// called in between
+		const std::vector<Pair>& findPairs(const BallStore& balls, Real reach,
+			const std::vector<int>& active, const std::vector<int>& activeSlot);
+
+		// any ball may have moved; the next call sorts from scratch
+		void invalidate(void) { m_order.clear(); }
+
+		// make room for count balls and a few candidate pairs per ball
+		void reserve(int count);
+
+	private:
+		void sortByX(const BallStore& balls);
+		void restoreOrder(const Real* x, const std::vector<int>& active);
+
+		std::vector<int>    m_order;   // ball indices sorted by x
+		std::vector<int>    m_rank;    // position of each ball in m_order
+		std::vector<Pair>   m_pairs;
+	};
+}
+
+#endif // __broadPhaseH__
@@ -0,0 +1,344 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: cushions.cpp
+//
+// Cushion geometry and its segment grid. See cushions.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "cushions.h"
+#include "billiardSim.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+namespace sim
+{
+	// the grid has at most this many cells on a side; big layouts get big cells
+	static const int MAX_CELLS = 64;
+
+	static const Extent UNBOUNDED = { -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX };
+
+	// point of segment s closest to (x, z)
+	static void closestPoint(const Cushions::Segment& s, Real x, Real z, Real& cx, Real& cz)
+	{
+		Real ex = s.bx - s.ax, ez = s.bz - s.az;
+		Real len2 = ex * ex + ez * ez;
+		Real t = len2 > 0 ? ((x - s.ax) * ex + (z - s.az) * ez) / len2 : 0;
+		t = std::max((Real)0, std::min(t, (Real)1));
+		cx = s.ax + ex * t;
+		cz = s.az + ez * t;
+	}
+
+	Cushions::Cushions(void)
+	{
+		m_radius = 0;
+		m_restitution = 1;
+		m_friction = 0;
+		m_cellSize = 1;
+		m_originX = m_originZ = 0;
+		m_cols = m_rows = 0;
+		m_dirty = true;
+		m_limits = UNBOUNDED;
+	}
+
+	void Cushions::clear(void)
+	{
+		m_segments.clear();
+		m_dirty = true;
+	}
+
+	void Cushions::addSegment(float ax, float az, float bx, float bz)
+	{
+		Segment s = { ax, az, bx, bz };
+		m_segments.push_back(s);
+		m_dirty = true;
+	}
+
+	void Cushions::addPolygon(const float pts[][2], int count)
+	{
+		for (int k = 0; k < count; k++) {
+			int next = (k + 1) % count;
+			addSegment(pts[k][0], pts[k][1], pts[next][0], pts[next][1]);
+		}
+	}
+
+	void Cushions::addBox(float x, float z, float width, float depth)
+	{
+		float w = width / 2, d = depth / 2;
+		const float pts[4][2] = { { x - w, z - d }, { x + w, z - d }, { x + w, z + d }, { x - w, z + d } };
+		addPolygon(pts, 4);
+	}
+
+	void Cushions::build(Real radius)
+	{
+		if (!m_dirty && radius == m_radius)
+			return;
+		m_radius = radius;
+		m_dirty = false;
+		m_cellStart.clear();
+		m_cellItems.clear();
+		m_cols = m_rows = 0;
+		m_limits = UNBOUNDED;
+		if (m_segments.empty())
+			return;
+
+		Extent e = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+		Real length = 0;
+		for (size_t k = 0; k < m_segments.size(); k++) {
+			const Segment& s = m_segments[k];
+			length += std::sqrt((s.bx - s.ax) * (s.bx - s.ax) + (s.bz - s.az) * (s.bz - s.az));
+			e.minX = std::min(e.minX, std::min(s.ax, s.bx));
+			e.maxX = std::max(e.maxX, std::max(s.ax, s.bx));
+			e.minZ = std::min(e.minZ, std::min(s.az, s.bz));
+			e.maxZ = std::max(e.maxZ, std::max(s.az, s.bz));
+		}
+
+		// a center past the outermost cushions less one radius has gone through
+		// them. the limits never cross, even for a layout narrower than a ball
+		Real midX = (e.minX + e.maxX) / 2, midZ = (e.minZ + e.maxZ) / 2;
+		m_limits.minX = std::min(e.minX + radius, midX);
+		m_limits.maxX = std::max(e.maxX - radius, midX);
+		m_limits.minZ = std::min(e.minZ + radius, midZ);
+		m_limits.maxZ = std::max(e.maxZ - radius, midZ);
+
+		// the grid covers every point within one radius of a segment
+		m_originX = (float)(e.minX - radius);
+		m_originZ = (float)(e.minZ - radius);
+		float sizeX = (float)(e.maxX - e.minX + 2 * radius), sizeZ = (float)(e.maxZ - e.minZ + 2 * radius);
+		// cells of about two ball diameters, smaller for finely cut outlines
+		// so a cell does not collect many short segments
+		float fine = (float)(2 * length / m_segments.size());
+		float r = (float)radius;
+		m_cellSize = std::max(std::min(4 * r, std::max(fine, r)), std::max(sizeX, sizeZ) / MAX_CELLS);
+		m_cols = std::min(MAX_CELLS, (int)(sizeX / m_cellSize) + 1);
+		m_rows = std::min(MAX_CELLS, (int)(sizeZ / m_cellSize) + 1);
+
+		// a segment goes into every cell whose center is within one radius
+		// plus half a cell diagonal of it, which holds every cell its capsule
+		// overlaps. (cell, segment) pairs are then sorted into the cell lists
+		std::vector<std::pair<int, int> > entries;
+		float reach = r + m_cellSize * 0.7072f;
+		for (int k = 0; k < (int)m_segments.size(); k++) {
+			const Segment& s = m_segments[k];
+			int c0, r0, c1, r1;
+			cellOf(std::min(s.ax, s.bx) - radius, std::min(s.az, s.bz) - radius, c0, r0);
+			cellOf(std::max(s.ax, s.bx) + radius, std::max(s.az, s.bz) + radius, c1, r1);
+			for (int row = r0; row <= r1; row++) {
+				for (int col = c0; col <= c1; col++) {
+					Real x = m_originX + (col + 0.5f) * m_cellSize, z = m_originZ + (row + 0.5f) * m_cellSize;
+					Real cx, cz;
+					closestPoint(s, x, z, cx, cz);
+					if ((x - cx) * (x - cx) + (z - cz) * (z - cz) <= reach * reach)
+						entries.push_back(std::make_pair(row * m_cols + col, k));
+				}
+			}
+		}
+		std::sort(entries.begin(), entries.end());
+
+		int cells = m_cols * m_rows;
+		m_cellStart.assign(cells + 1, 0);
+		m_cellItems.resize(entries.size());
+		for (size_t k = 0; k < entries.size(); k++) {
+			m_cellStart[entries[k].first + 1]++;
+			m_cellItems[k] = entries[k].second;
+		}
+		for (int c = 0; c < cells; c++)
+			m_cellStart[c + 1] += m_cellStart[c];
+	}
+
+	// cell holding (x, z), clamped to the grid. false when the point is outside it
+	bool Cushions::cellOf(double x, double z, int& col, int& row) const
+	{
+		double fc = floor((x - m_originX) / m_cellSize), fr = floor((z - m_originZ) / m_cellSize);
+		col = (int)std::max(0.0, std::min(fc, (double)(m_cols - 1)));
+		row = (int)std::max(0.0, std::min(fr, (double)(m_rows - 1)));
+		return fc >= 0 && fc < m_cols && fr >= 0 && fr < m_rows;
+	}
+
+	int Cushions::collide(BallStore& balls, int i) const
+	{
+		int col, row;
+		if (m_cols == 0 || !cellOf(balls.x[i], balls.z[i], col, row))
+			return -1;
+
+		int touched = -1;
+		int cell = row * m_cols + col;
+		for (int k = m_cellStart[cell]; k < m_cellStart[cell + 1]; k++) {
+			Real cx, cz;
+			closestPoint(m_segments[m_cellItems[k]], balls.x[i], balls.z[i], cx, cz);
+			Real dx = balls.x[i] - cx, dz = balls.z[i] - cz;
+			if (dx * dx + dz * dz < m_radius * m_radius) {
+				bounce(balls, i, m_cellItems[k]);
+				touched = m_cellItems[k];
+			}
+		}
+		return touched;
+	}
+
+	void Cushions::bounce(BallStore& balls, int i, int k) const
+	{
+		bounce(balls.x[i], balls.z[i], balls.vx[i], balls.vz[i], &balls.w[i], k);
+	}
+
+	void Cushions::bounce(Real& x, Real& z, Real& vx, Real& vz, int k) const
+	{
+		bounce(x, z, vx, vz, NULL, k);
+	}
+
+	// the speed into the cushion vn comes back as -restitution * vn. with
+	// friction the rim of the ball grips the cushion: the point touching it
+	// slips along it at c = (v + w) . t, and the cushion pushes against the
+	// slip with up to friction times the normal push, a push j taking j off
+	// the speed along t and 5/2 j off w (a solid sphere), until c is gone
+	void Cushions::bounce(Real& x, Real& z, Real& vx, Real& vz, Real* w, int k) const
+	{
+		const Segment& s = m_segments[k];
+		Real cx, cz;
+		closestPoint(s, x, z, cx, cz);
+
+		Real nx = x - cx, nz = z - cz;
+		Real len = std::sqrt(nx * nx + nz * nz);
+		if (len == 0) {
+			// center right on the segment: send it back the way it came
+			nx = s.az - s.bz;
+			nz = s.bx - s.ax;
+			len = std::sqrt(nx * nx + nz * nz);
+			if (nx * vx + nz * vz > 0)
+				len = -len;
+		}
+		if (len == 0)
+			return;
+		nx /= len;
+		nz /= len;
+
+		x = cx + nx * m_radius;
+		z = cz + nz * m_radius;
+		Real vn = vx * nx + vz * nz;
+		if (vn >= 0)
+			return;
+		vx -= (1 + m_restitution) * vn * nx;
+		vz -= (1 + m_restitution) * vn * nz;
+		if (m_friction > 0) {
+			Real tx = -nz, tz = nx;
+			Real c = vx * tx + vz * tz + (w ? *w : 0);
+			Real j = std::min(std::fabs(c) * (Real)(2.0 / 7), -m_friction * (1 + m_restitution) * vn);
+			if (c < 0)
+				j = -j;
+			vx -= j * tx;
+			vz -= j * tz;
+			if (w)
+				*w -= (Real)2.5 * j;
+		}
+	}
+
+	// d at which a ball at (x, z) moving by (ux, uz) comes within one radius
+	// of (cx, cz), or -1 if it does not approach it. 0 when already inside
+	double Cushions::circleImpact(double cx, double cz, double x, double z, double ux, double uz) const
+	{
+		double px = x - cx, pz = z - cz;
+		double bb = px * ux + pz * uz;
+		if (bb >= 0)
+			return -1;
+		double a = ux * ux + uz * uz;
+		double c = px * px + pz * pz - (double)m_radius * m_radius;
+		double disc = bb * bb - a * c;
+		if (disc < 0)
+			return -1;
+		return c <= 0 ? 0 : c / (-bb + sqrt(disc));
+	}
+
+	double Cushions::segmentImpact(int k, double x, double z, double ux, double uz) const
+	{
+		const Segment& s = m_segments[k];
+		double ex = s.bx - s.ax, ez = s.bz - s.az;
+		double len = sqrt(ex * ex + ez * ez);
+
+		// the flat side facing the ball. when it is reached within the
+		// segment, no end can be reached before it
+		if (len > 0) {
+			double nx = -ez / len, nz = ex / len;
+			double dist = (x - s.ax) * nx + (z - s.az) * nz;
+			if (dist < 0) {
+				nx = -nx;   nz = -nz;   dist = -dist;
+			}
+			double un = ux * nx + uz * nz;
+			if (un < 0) {
+				double d = std::max(0.0, (dist - m_radius) / -un);
+				double along = ((x + ux * d - s.ax) * ex + (z + uz * d - s.az) * ez) / len;
+				if (along >= 0 && along <= len)
+					return d;
+			}
+		}
+
+		double da = circleImpact(s.ax, s.az, x, z, ux, uz);
+		double db = circleImpact(s.bx, s.bz, x, z, ux, uz);
+		if (da < 0)
+			return db;
+		if (db < 0)
+			return da;
+		return std::min(da, db);
+	}
+
+	double Cushions::timeOfImpact(double x, double z, double ux, double uz, double maxTravel, int& segment) const
+	{
+		segment = -1;
+		if (m_cols == 0 || (ux == 0 && uz == 0))
+			return -1;
+
+		// clip the path to the grid; nothing can be touched outside it
+		double d0 = 0, d1 = maxTravel;
+		double lo[2] = { m_originX, m_originZ };
+		double hi[2] = { m_originX + m_cols * m_cellSize, m_originZ + m_rows * m_cellSize };
+		double p[2] = { x, z }, u[2] = { ux, uz };
+		for (int a = 0; a < 2; a++) {
+			if (u[a] == 0) {
+				if (p[a] < lo[a] || p[a] > hi[a])
+					return -1;
+				continue;
+			}
+			double t0 = (lo[a] - p[a]) / u[a], t1 = (hi[a] - p[a]) / u[a];
+			d0 = std::max(d0, std::min(t0, t1));
+			d1 = std::min(d1, std::max(t0, t1));
+		}
+		if (d0 > d1)
+			return -1;
+
+		// walk the cells along the path. once the best impact so far lies in
+		// the cells already walked, no later cell can hold an earlier one
+		int col, row;
+		cellOf(x + ux * d0, z + uz * d0, col, row);
+		int stepCol = ux > 0 ? 1 : -1, stepRow = uz > 0 ? 1 : -1;
+		double deltaCol = ux != 0 ? m_cellSize / fabs(ux) : HUGE_VAL;
+		double deltaRow = uz != 0 ? m_cellSize / fabs(uz) : HUGE_VAL;
+		double nextCol = ux != 0 ? (m_originX + (col + (ux > 0)) * m_cellSize - x) / ux : HUGE_VAL;
+		double nextRow = uz != 0 ? (m_originZ + (row + (uz > 0)) * m_cellSize - z) / uz : HUGE_VAL;
+
+		double best = -1;
+		for (;;) {
+			int cell = row * m_cols + col;
+			for (int k = m_cellStart[cell]; k < m_cellStart[cell + 1]; k++) {
+				double d = segmentImpact(m_cellItems[k], x, z, ux, uz);
+				if (d >= 0 && d <= maxTravel && (best < 0 || d < best)) {
+					best = d;
+					segment = m_cellItems[k];
+				}
+			}
+
+			double cellEnd = std::min(std::min(nextCol, nextRow), d1);
+			if ((best >= 0 && best <= cellEnd) || cellEnd >= d1)
+				break;
+			if (nextCol < nextRow) {
+				col += stepCol;
+				nextCol += deltaCol;
+			}
+			else {
+				row += stepRow;
+				nextRow += deltaRow;
+			}
+			if (col < 0 || col >= m_cols || row < 0 || row >= m_rows)
+				break;
+		}
+		return best;
+	}
+}
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: cushions.h
+//
+// Cushion geometry of the table as a set of line segments: the rails, and
+// any pockets, bumpers or custom outlines added as polygons. A ball touches
+// a segment when its center comes within one radius of it, so every segment
+// acts as a capsule for the ball centers.
+// Segments are binned into a uniform grid, each cell listing the segments
+// within one radius of it, so a ball only tests the cushions next to it and
+// the cost of a step does not grow with the size of the layout.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __cushionsH__
+#define __cushionsH__
+
+#include <vector>
+#include "real.h"
+
+namespace sim
+{
+	class BallStore;
+
+	// axis-aligned box, used for the area ball centers are kept in
+	struct Extent {
+		Real minX, minZ, maxX, maxZ;
+	};
+
+	class Cushions {
+	public:
+		struct Segment {
+			Real ax, az, bx, bz;
+		};
+
+		Cushions(void);
+
+		void clear(void);
+		void addSegment(float ax, float az, float bx, float bz);
+		// closed outline through count points (x, z), in either winding
+		void addPolygon(const float pts[][2], int count);
+		// axis-aligned block centered on (x, z), like the rails CWall draws
+		void addBox(float x, float z, float width, float depth);
+
+		// how balls leave a cushion: the share of their speed into it they
+		// keep, and the grip that trades side spin (BallStore::w) with speed
+		// along it. (1, 0), a mirror reflection, unless set; World::setModel
+		// sets it. clear() keeps it
+		void setResponse(Real restitution, Real friction) { m_restitution = restitution;   m_friction = friction; }
+
+		int segmentCount(void) const { return (int)m_segments.size(); }
+		const Segment& segment(int k) const { return m_segments[k]; }
+
+		// bin the segments for balls of the given radius. does nothing when
+		// neither the segments nor the radius changed since the last call
+		void build(Real radius);
+
+		// box that holds every point a ball center can reach inside the
+		// cushions (their extent less one radius). unbounded with no cushions.
+		// valid after build()
+		const Extent& limits(void) const { return m_limits; }
+
+		// push ball i out of every cushion it overlaps and turn it away from
+		// them. returns the last segment it touched, or -1
+		int collide(BallStore& balls, int i) const;
+
+		// push ball i out of segment k and send it off the segment, as set
+		// by setResponse(), if it is moving into it
+		void bounce(BallStore& balls, int i, int k) const;
+		// the same for a ball at (x, z) moving with (vx, vz), without side spin
+		void bounce(Real& x, Real& z, Real& vx, Real& vz, int k) const;
+
+		// earliest d in [0, maxTravel] at which a ball at (x, z) moving to
+		// (x, z) + (ux, uz) * d touches a cushion it is approaching, or -1.
+		// segment is set to the cushion touched
+		double timeOfImpact(double x, double z, double ux, double uz, double maxTravel, int& segment) const;
+
+	private:
+		double segmentImpact(int k, double x, double z, double ux, double uz) const;
+		double circleImpact(double cx, double cz, double x, double z, double ux, double uz) const;
+		bool cellOf(double x, double z, int& col, int& row) const;
+		void bounce(Real& x, Real& z, Real& vx, Real& vz, Real* w, int k) const;
+
+		std::vector<Segment>    m_segments;
+		std::vector<int>        m_cellStart;    // cols * rows + 1 offsets into m_cellItems
+		std::vector<int>        m_cellItems;    // segment indices, cell by cell
+		Real                    m_radius;
+		Real                    m_restitution;
+		Real                    m_friction;
+		float                   m_cellSize;
+		float                   m_originX, m_originZ;
+		int                     m_cols, m_rows;
+		bool                    m_dirty;
+		Extent                  m_limits;
+	};
+}
+
+#endif // __cushionsH__
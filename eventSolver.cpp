@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: eventSolver.cpp
+//
+// Event-driven (continuous) solver for the table. See eventSolver.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "eventSolver.h"
+#include "billiardSim.h"
+#include "profiler.h"
+#include <cmath>
+#include <algorithm>
+
+namespace sim
+{
+	// a call never handles more events than this; guards against a pair that
+	// keeps reporting impacts at the same instant
+	static const int MAX_EVENTS = 100000;
+
+	// a rigid world goes to rest in steps of this long
+	static const Real RIGID_STEP = (Real)(1.0 / 30);
+
+	// squared cosine below which a touching pair only grazes (see nextEvent)
+	static const double GRAZE = 1e-12;
+
+	// D(t) is bounded by D_MAX = TIME_SCALE / k as t goes to infinity
+	static double maxTravel(const World& world)
+	{
+		return TIME_SCALE / world.getDamping();
+	}
+
+	static double travel(const World& world, double t)
+	{
+		return maxTravel(world) * (1 - exp(-world.getDamping() * t));
+	}
+
+	// inverse of travel(); negative when d can never be reached
+	static double timeOfTravel(const World& world, double d)
+	{
+		double dMax = maxTravel(world);
+		if (d >= dMax)
+			return -1;
+		return -log(1 - d / dMax) / world.getDamping();
+	}
+
+	// every ball shares D(t), which only grows with t, so the earliest event
+	// is the one at the least travel. events are compared in D and only the
+	// one found is turned into a time: one exp and one log per event, where
+	// comparing times took a log per ball and per candidate pair
+	EventSolver::Event EventSolver::nextEvent(const World& world, double limit, int& pairsTested)
+	{
+		const BallStore& b = world.balls();
+		const Cushions& cushions = world.cushions();
+		const double reach = 2 * world.getRadius();
+		const double dMax = maxTravel(world);
+		const std::vector<int>& active = world.m_active;
+		int n = b.size();
+		Event e;
+		e.type = EVENT_NONE;
+		e.time = limit;
+		e.travel = travel(world, limit);
+		e.i = e.j = -1;
+
+		// sleeping balls do not move, so only awake ones can start an event
+		for (size_t k = 0; k < active.size(); k++) {
+			int i = active[k];
+			double vx = b.vx[i], vz = b.vz[i];
+			if (vx == 0 && vz == 0)
+				continue;
+
+			// the ball comes to rest once speed * exp(-k * t) is down to
+			// STOP_SPEED, which is at D = D_MAX * (1 - STOP_SPEED / speed)
+			double speed = std::max(fabs(vx), fabs(vz));
+			double d = speed > STOP_SPEED ? dMax * (1 - STOP_SPEED / speed) : 0;
+			if (d < e.travel) { e.type = EVENT_STOP; e.travel = d; e.i = i; }
+
+			// cushions, no further than the ball gets before the earliest event
+			// so far. a ball already in one is sent back at once
+			int segment;
+			d = cushions.timeOfImpact(b.x[i], b.z[i], vx, vz, e.travel, segment);
+			if (d >= 0 && d < e.travel) { e.type = EVENT_CUSHION; e.travel = d; e.i = i; e.j = segment; }
+
+			// other balls: |p + u*D|^2 = reach^2 with p, u relative to ball i
+			for (int j = 0; j < n; j++) {
+				if (j == i || (j < i && (b.vx[j] != 0 || b.vz[j] != 0)))
+					continue;   // moving pairs are tested once, from the lower index
+				pairsTested++;
+				double px = b.x[j] - b.x[i], pz = b.z[j] - b.z[i];
+				double ux = b.vx[j] - vx, uz = b.vz[j] - vz;
+				double bb = px * ux + pz * uz;
+				if (bb >= 0)
+					continue;   // not approaching
+				double a = ux * ux + uz * uz;
+				double c = px * px + pz * pz - reach * reach;
+				double disc = bb * bb - a * c;
+				if (disc < 0)
+					continue;   // passes by
+				// touching balls whose motion is square to the line of centers
+				// to within float rounding: hitBy() cannot change them, and the
+				// same impact would be found again at once. let them slide past
+				if (c <= 0 && bb * bb < GRAZE * a * (px * px + pz * pz))
+					continue;
+				d = c <= 0 ? 0 : c / (-bb + sqrt(disc));
+				if (d < e.travel) { e.type = EVENT_BALL; e.travel = d; e.i = i; e.j = j; }
+			}
+		}
+		if (e.type != EVENT_NONE)
+			e.time = std::min(timeOfTravel(world, e.travel), limit);
+		return e;
+	}
+
+	// exp(-k * t) = 1 - D(t) / D_MAX, so the decay needs no exp either
+	void EventSolver::drift(World& world, double d)
+	{
+		BallStore& b = world.balls();
+		const std::vector<int>& active = world.m_active;
+		Real move = (Real)d;
+		Real decay = (Real)(1 - d / maxTravel(world));
+		for (size_t k = 0; k < active.size(); k++) {
+			int i = active[k];
+			b.x[i] += b.vx[i] * move;
+			b.z[i] += b.vz[i] * move;
+			b.vx[i] *= decay;
+			b.vz[i] *= decay;
+		}
+	}
+
+	void EventSolver::apply(World& world, const Event& e)
+	{
+		BallStore& b = world.balls();
+		switch (e.type) {
+		case EVENT_STOP:
+			b.vx[e.i] = 0;
+			b.vz[e.i] = 0;
+			world.sleep(e.i);
+			break;
+		case EVENT_CUSHION:
+			world.addContact(ContactEvent::CUSHION, e.i, e.j);
+			world.cushions().bounce(b, e.i, e.j);
+			break;
+		case EVENT_BALL:
+			world.wake(e.j);
+			world.addContact(ContactEvent::BALL, e.i, e.j);
+			world.hitBy(e.i, e.j);
+			break;
+		default:
+			break;
+		}
+	}
+
+	int EventSolver::advance(World& world, double dt)
+	{
+		PROFILE_SCOPE("event solver");
+		int count = 0;
+		world.m_cushions.build(world.getRadius());
+		if (world.getModel() == World::RIGID)
+			return world.stepBalls((Real)dt);
+		// balls move here without the broad phase seeing them
+		world.m_broadPhase.invalidate();
+		// awake balls already at rest have no event to send them to sleep
+		for (int k = (int)world.m_active.size() - 1; k >= 0; k--) {
+			int i = world.m_active[k];
+			if (world.m_balls.vx[i] == 0 && world.m_balls.vz[i] == 0)
+				world.sleep(i);
+		}
+		while (count < MAX_EVENTS) {
+			Event e = nextEvent(world, dt, world.m_pairsTested);
+			drift(world, e.travel);
+			dt -= e.time;
+			// a run to rest ends on no event after an unbounded time
+			if (e.time < HUGE_VAL)
+				world.m_shotTime += e.time;
+			if (e.type == EVENT_NONE)
+				break;
+			apply(world, e);
+			count++;
+		}
+		PROFILE_COUNT("events", count);
+		return count;
+	}
+
+	int EventSolver::runToRest(World& world)
+	{
+		int count = 0;
+		world.m_pairsTested = 0;
+		double dt = world.getModel() == World::RIGID ? RIGID_STEP : HUGE_VAL;
+		while (!world.isStopped() && count < MAX_EVENTS)
+			count += advance(world, dt);
+		return count;
+	}
+}
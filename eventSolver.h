@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: eventSolver.h
+//
+// Event-driven (continuous) solver for the table.
+// Between two events every ball follows the closed form of the damped motion
+//     v(t) = v0 * exp(-k * t)
+//     p(t) = p0 + v0 * D(t),   D(t) = TIME_SCALE * (1 - exp(-k * t)) / k
+// where k is the damping rate of the world (World::getDamping).
+// All balls share D(t), so ball-ball impacts solve a quadratic in D and
+// cushion impacts are found by casting the ball's path through the cushion
+// grid (see cushions.h). The solver jumps from one impact or
+// stop event to the next, so fast balls never tunnel and the result does
+// not depend on how time is sliced into frames.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __eventSolverH__
+#define __eventSolverH__
+
+namespace sim
+{
+	class World;
+
+	class EventSolver {
+	public:
+		// advance world by dt seconds, handling every event inside it.
+		// returns the number of events handled. a world under the
+		// rigid-ball model has no closed form and takes fixed steps
+		// instead; the steps are returned then
+		static int advance(World& world, double dt);
+
+		// advance world until every ball is at rest
+		static int runToRest(World& world);
+
+	private:
+		enum EventType { EVENT_NONE, EVENT_STOP, EVENT_BALL, EVENT_CUSHION };
+
+		struct Event {
+			EventType   type;
+			double      time;
+			double      travel; // D(time)
+			int         i, j;   // j is the segment of a cushion event
+		};
+
+		static Event nextEvent(const World& world, double limit, int& pairsTested);
+		// move the awake balls on by a travel of d
+		static void drift(World& world, double d);
+		static void apply(World& world, const Event& e);
+	};
+}
+
+#endif // __eventSolverH__
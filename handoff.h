@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: handoff.h
+//
+// Lock-free handoff between exactly two threads.
+// TripleBuffer passes the latest state from a producer to a consumer: the
+// producer always has a slot to write, the consumer always reads a whole
+// state, and neither ever waits for the other. States the consumer is too
+// slow to see are skipped.
+// SpscQueue passes every item, in order, through a fixed ring.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __handoffH__
+#define __handoffH__
+
+#include <atomic>
+
+namespace sim
+{
+	template <class T>
+	class TripleBuffer {
+	public:
+		TripleBuffer(void) : m_back(0), m_middle(1), m_front(2) {}
+
+		// producer: the slot to fill, then publish() hands it over
+		T& back(void) { return m_slots[m_back]; }
+		void publish(void)
+		{
+			m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+		}
+
+		// consumer: take the latest published slot, if there is a new one.
+		// front() stays valid until the next successful update()
+		bool update(void)
+		{
+			if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0)
+				return false;
+			m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+			return true;
+		}
+		const T& front(void) const { return m_slots[m_front]; }
+
+	private:
+		enum { INDEX = 3, FRESH = 4 };
+
+		TripleBuffer(const TripleBuffer&);
+		TripleBuffer& operator=(const TripleBuffer&);
+
+		T                   m_slots[3];
+		int                 m_back;     // producer only
+		std::atomic<int>    m_middle;   // slot index, FRESH once published
+		int                 m_front;    // consumer only
+	};
+
+	// N must be a power of two
+	template <class T, unsigned int N>
+	class SpscQueue {
+	public:
+		SpscQueue(void) : m_head(0), m_tail(0) {}
+
+		// producer. false when the queue is full
+		bool push(const T& item)
+		{
+			unsigned int tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_head.load(std::memory_order_acquire) == N)
+				return false;
+			m_items[tail & (N - 1)] = item;
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// consumer. false when the queue is empty
+		bool pop(T& item)
+		{
+			unsigned int head = m_head.load(std::memory_order_relaxed);
+			if (head == m_tail.load(std::memory_order_acquire))
+				return false;
+			item = m_items[head & (N - 1)];
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		SpscQueue(const SpscQueue&);
+		SpscQueue& operator=(const SpscQueue&);
+
+		T                           m_items[N];
+		std::atomic<unsigned int>   m_head;     // next item to pop
+		std::atomic<unsigned int>   m_tail;     // next slot to push
+	};
+}
+
+#endif // __handoffH__
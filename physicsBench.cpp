@@ -0,0 +1,806 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: physicsBench.cpp
+//
+// Microbenchmarks and scaling runs of the headless physics kernels.
+// A small harness in the style of Google Benchmark: every benchmark runs
+// with growing iteration counts until it has taken --min-time seconds, then
+// reports the time per iteration and its own rates (ns/ball-step, shots/sec).
+// Given the --json output of an earlier run as a baseline, it also reports
+// the speedup of every benchmark over it.
+//
+//   physicsBench [--json] [--filter=<substring>] [--min-time=<seconds>]
+//                [--baseline=<file.json>]
+//
+// Built as the physicsBench target of CMakeLists.txt; numbers only mean
+// something in an optimized build, which is that file's default.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "billiardSim.h"
+#include "broadPhase.h"
+#include "shotCache.h"
+#include "shotEnv.h"
+#include "shotPreview.h"
+#include "shotSearch.h"
+#include "table.h"
+#include "threadPool.h"
+#include "trajectory.h"
+#include "scene.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+
+using namespace sim;
+
+// ----- harness -----
+
+// results are folded into this so the optimizer cannot drop the work
+static volatile Real g_sink;
+
+class BenchState {
+public:
+	explicit BenchState(int arg) : m_arg(arg), m_iterations(0), m_items(0), m_paused(0) {}
+
+	int arg(void) const { return m_arg; }
+	long long iterations(void) const { return m_iterations; }
+
+	// work done per iteration, in the unit the benchmark reports a rate of
+	void setItemsPerIteration(double items) { m_items = items; }
+	double itemsPerIteration(void) const { return m_items; }
+
+	// time spent between pause() and resume() is not counted
+	void pause(void) { m_pauseStart = Clock::now(); }
+	void resume(void) { m_paused += std::chrono::duration<double>(Clock::now() - m_pauseStart).count(); }
+	double pausedSeconds(void) const { return m_paused; }
+
+	void start(long long iterations) { m_iterations = iterations;   m_paused = 0; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	int                 m_arg;
+	long long           m_iterations;
+	double              m_items;
+	double              m_paused;
+	Clock::time_point   m_pauseStart;
+};
+
+// run(state) builds its fixture between pause() and resume(), then does
+// state.iterations() iterations
+struct Benchmark {
+	const char*     name;
+	const char*     rateName;       // "ns/ball-step", "ns/step", "ns/pair", "ns/preview", "ns/shot", "ns/seek", "shots/sec", "loads/sec" or "decisions/sec"
+	bool            perItemNs;      // rate is ns per item, else items per second
+	void            (*run)(BenchState&);
+	std::vector<int> args;
+
+	Benchmark(const char* iname, const char* irateName, bool iperItemNs, void (*irun)(BenchState&))
+		: name(iname), rateName(irateName), perItemNs(iperItemNs), run(irun) {}
+};
+
+struct BenchResult {
+	std::string     name;
+	long long       iterations;
+	double          nsPerIteration;
+	const char*     rateName;
+	double          rate;
+};
+
+static BenchResult runBenchmark(const Benchmark& b, int arg, double minTime)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	BenchState state(arg);
+	long long iterations = 1;
+	double seconds = 0;
+	for (;;) {
+		state.start(iterations);
+		Clock::time_point t0 = Clock::now();
+		b.run(state);
+		seconds = std::chrono::duration<double>(Clock::now() - t0).count() - state.pausedSeconds();
+		if (seconds >= minTime || iterations >= 1000000000LL)
+			break;
+
+		// aim a little past minTime, growing by at most 10x per round
+		double scale = seconds > 0 ? 1.4 * minTime / seconds : 10;
+		if (scale > 10) scale = 10;
+		if (scale < 2) scale = 2;
+		iterations = (long long)(iterations * scale);
+	}
+
+	BenchResult r;
+	char name[128];
+	snprintf(name, sizeof(name), "%s/%d", b.name, arg);
+	r.name = name;
+	r.iterations = iterations;
+	r.nsPerIteration = seconds * 1e9 / iterations;
+	r.rateName = b.rateName;
+	double items = state.itemsPerIteration() * iterations;
+	if (b.perItemNs)
+		r.rate = items > 0 ? seconds * 1e9 / items : 0;
+	else
+		r.rate = seconds > 0 ? items / seconds : 0;
+	return r;
+}
+
+// ----- fixtures -----
+
+static unsigned int g_seed = 12345;
+
+static float randomUnit(void)   // [-1, 1)
+{
+	g_seed = g_seed * 1664525u + 1013904223u;
+	return (float)(g_seed >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+// count balls on a jittered grid over the standard 9 x 6 table. up to about
+// 200 balls they do not touch; past that the grid shrinks and they overlap,
+// which is what the ball-ball kernels are stressed with
+static void rackTable(World& world, int count)
+{
+	int cols = 1;
+	while (cols * (int)(cols * BOUND_Z / BOUND_X + 1) < count)
+		cols++;
+	int rows = (count + cols - 1) / cols;
+
+	Real dx = 2 * BOUND_X / cols, dz = 2 * BOUND_Z / rows;
+	Real jitter = (Real)std::max(0.0, std::min(dx, dz) / 2 - M_RADIUS * 1.05);
+
+	std::vector<float> pos(2 * count);
+	g_seed = 12345;
+	for (int i = 0; i < count; i++) {
+		pos[2 * i] = (float)(-BOUND_X + dx * (i % cols + 0.5f) + jitter * randomUnit());
+		pos[2 * i + 1] = (float)(-BOUND_Z + dz * (i / cols + 0.5f) + jitter * randomUnit());
+	}
+	world.reset((const float(*)[2]) & pos[0], count);
+
+	float wallGeom[4][4] = {
+		{ 0, 3.06f, 9, 0.12f }, { 0, -3.06f, 9, 0.12f },
+		{ 4.56f, 0, 0.12f, 6.24f }, { -4.56f, 0, 0.12f, 6.24f },
+	};
+	world.cushions().clear();
+	for (int i = 0; i < 4; i++)
+		world.cushions().addBox(wallGeom[i][0], wallGeom[i][1], wallGeom[i][2], wallGeom[i][3]);
+	world.cushions().build(world.getRadius());
+}
+
+// an oval outline of count segments inscribed in the rails, the kind of
+// custom table shape that takes many short cushions
+static void addOval(World& world, int count)
+{
+	std::vector<float> pts(2 * count);
+	for (int p = 0; p < count; p++) {
+		float a = p * 6.2831853f / count;
+		pts[2 * p] = 4.5f * cosf(a);
+		pts[2 * p + 1] = 3.0f * sinf(a);
+	}
+	world.cushions().addPolygon((const float(*)[2]) & pts[0], count);
+	world.cushions().build(world.getRadius());
+}
+
+static void scatterVelocities(World& world, float speed)
+{
+	for (int i = 0; i < world.ballCount(); i++)
+		world.setPower(i, speed * randomUnit(), speed * randomUnit());
+}
+
+// ----- benchmarks -----
+
+// integrate: move and damp every ball for one 1/120 s step
+static void benchIntegrate(BenchState& state)
+{
+	state.pause();
+	World world;
+	rackTable(world, state.arg());
+	scatterVelocities(world, 2);
+	state.resume();
+
+	BallStore& balls = world.balls();
+	for (long long k = 0; k < state.iterations(); k++)
+		integrate(balls, 1.0f / 120, DAMPING, world.cushions().limits());
+	g_sink = balls.x[0];
+	state.setItemsPerIteration(state.arg());
+}
+
+// integrateRigid: the same step under the rigid-ball model, every ball
+// sliding at first
+static void benchIntegrateRigid(BenchState& state)
+{
+	state.pause();
+	World world;
+	rackTable(world, state.arg());
+	scatterVelocities(world, 2);
+	BallPhysics physics;
+	state.resume();
+
+	BallStore& balls = world.balls();
+	for (long long k = 0; k < state.iterations(); k++)
+		integrateRigid(balls, 1.0f / 120, physics, world.cushions().limits());
+	g_sink = balls.x[0];
+	state.setItemsPerIteration(state.arg());
+}
+
+// Cushions::collide: test and resolve every ball against the cushions of
+// its grid cell. half of the balls sit on a rail so both branches are exercised
+static void benchCushionCollide(BenchState& state)
+{
+	state.pause();
+	World world;
+	rackTable(world, state.arg());
+	scatterVelocities(world, 2);
+	BallStore& balls = world.balls();
+	for (int i = 0; i < balls.size(); i += 2)
+		balls.x[i] = (i & 2) ? BOUND_X + 0.01f : -BOUND_X - 0.01f;
+	state.resume();
+
+	int n = balls.size();
+	for (long long k = 0; k < state.iterations(); k++) {
+		for (int i = 0; i < n; i++)
+			world.cushions().collide(balls, i);
+	}
+	g_sink = balls.vx[0];
+	state.setItemsPerIteration(n);
+}
+
+// Cushions::collide on 1024 balls inside an oval of arg segments. the cost
+// per ball should stay flat as the outline gets finer
+static void benchCushionLayout(BenchState& state)
+{
+	state.pause();
+	World world;
+	rackTable(world, 1024);
+	addOval(world, state.arg());
+	scatterVelocities(world, 2);
+	state.resume();
+
+	BallStore& balls = world.balls();
+	int n = balls.size();
+	for (long long k = 0; k < state.iterations(); k++) {
+		for (int i = 0; i < n; i++)
+			world.cushions().collide(balls, i);
+	}
+	g_sink = balls.vx[0];
+	state.setItemsPerIteration(n);
+}
+
+// count balls on a square grid 2.5 radii apart, centred on the table and
+// as far past the rails as the count takes. every ball has its four sides
+// and four corners within 4 radii, whatever the count
+static void clusterBalls(World& world, int count)
+{
+	int cols = (int)std::ceil(std::sqrt((double)count));
+	Real gap = (Real)(2.5 * M_RADIUS), origin = -gap * (cols - 1) / 2;
+	std::vector<float> pos(2 * count);
+	for (int i = 0; i < count; i++) {
+		pos[2 * i] = (float)(origin + gap * (i % cols));
+		pos[2 * i + 1] = (float)(origin + gap * (i / cols));
+	}
+	world.reset((const float(*)[2]) & pos[0], count);
+}
+
+// World::hitBy: the collision response of every close pair of a cluster.
+// reported per pair, about four per ball. the balls are clustered, since
+// rackTable spreads a small count too far apart to make any pair
+static void benchBallHitBy(BenchState& state)
+{
+	state.pause();
+	World world;
+	clusterBalls(world, state.arg());
+	scatterVelocities(world, 2);
+	// pairs the broad phase reports at a reach that takes in the neighbours
+	BroadPhase broadPhase;
+	std::vector<BroadPhase::Pair> pairs = broadPhase.findPairs(world.balls(), (float)(4 * M_RADIUS));
+	state.resume();
+
+	for (long long k = 0; k < state.iterations(); k++) {
+		for (size_t p = 0; p < pairs.size(); p++)
+			world.hitBy(pairs[p].i, pairs[p].j);
+	}
+	g_sink = world.balls().vx[0];
+	state.setItemsPerIteration((double)pairs.size());
+}
+
+// World::step: one fixed step of the whole table (integrate, cushions,
+// broad phase and ball-ball contacts)
+static void benchStep(BenchState& state)
+{
+	state.pause();
+	World world;
+	rackTable(world, state.arg());
+	world.setFixedStep(1.0f / 120);
+	state.resume();
+
+	for (long long k = 0; k < state.iterations(); k++) {
+		// keep the table moving instead of measuring balls at rest
+		if (k % 256 == 0) {
+			state.pause();
+			scatterVelocities(world, 2);
+			world.clearContacts();
+			state.resume();
+		}
+		world.tick();
+	}
+	g_sink = world.balls().x[0];
+	state.setItemsPerIteration(state.arg());
+}
+
+// count balls three radii apart on a square grid, inside rails sized to fit
+// them, so no two touch at rest whatever the count
+static void rackSpacedTable(World& world, int count)
+{
+	int cols = 1;
+	while (cols * cols < count)
+		cols++;
+	float spacing = (float)(3 * M_RADIUS), half = cols * spacing / 2;
+
+	std::vector<float> pos(2 * count);
+	for (int i = 0; i < count; i++) {
+		pos[2 * i] = -half + spacing * (i % cols + 0.5f);
+		pos[2 * i + 1] = -half + spacing * (i / cols + 0.5f);
+	}
+	world.reset((const float(*)[2]) & pos[0], count);
+
+	world.cushions().clear();
+	world.cushions().addBox(0, half + 0.06f, 2 * half + 0.24f, 0.12f);
+	world.cushions().addBox(0, -half - 0.06f, 2 * half + 0.24f, 0.12f);
+	world.cushions().addBox(half + 0.06f, 0, 0.12f, 2 * half);
+	world.cushions().addBox(-half - 0.06f, 0, 0.12f, 2 * half);
+}
+
+// World::step with one ball struck into an otherwise resting rack, for the
+// first 256 steps of the shot. reported per step: sleeping balls cost
+// nothing, so the time should follow the few awake balls, not the rack size
+static void benchSparseStep(BenchState& state)
+{
+	World world;
+	world.setFixedStep(1.0f / 120);
+
+	for (long long k = 0; k < state.iterations(); k++) {
+		if (k % 256 == 0) {
+			state.pause();
+			rackSpacedTable(world, state.arg());
+			world.tick();
+			float angle = (float)(k / 256 % 64) * (6.2831853f / 64);
+			world.setPower(0, 2 * cosf(angle), 2 * sinf(angle));
+			state.resume();
+		}
+		world.tick();
+	}
+	g_sink = world.balls().x[0];
+	state.setItemsPerIteration(1);
+}
+
+// a full shot: the cue ball is struck into the rack and the event solver
+// runs the table until every ball is at rest
+static void benchShotToRest(BenchState& state)
+{
+	state.pause();
+	World table;
+	rackTable(table, state.arg());
+	table.setSolver(World::EVENT_DRIVEN);
+	World world;
+	state.resume();
+
+	for (long long k = 0; k < state.iterations(); k++) {
+		world = table;
+		float angle = (float)(k % 64) * (6.2831853f / 64);
+		world.setPower(0, 4 * cosf(angle), 4 * sinf(angle));
+		world.runToRest();
+	}
+	g_sink = world.balls().x[0];
+	state.setItemsPerIteration(1);
+}
+
+// the same shots under the rigid-ball model, with follow and draw. the
+// balls curve while they slide, so these go in fixed steps
+static void benchShotToRestRigid(BenchState& state)
+{
+	state.pause();
+	World table;
+	rackTable(table, state.arg());
+	table.setModel(World::RIGID);
+	World world;
+	state.resume();
+
+	for (long long k = 0; k < state.iterations(); k++) {
+		world = table;
+		float angle = (float)(k % 64) * (6.2831853f / 64);
+		world.strike(0, CueStroke(Vec2(cosf(angle), sinf(angle)), 4, 0, (float)(k % 5) * 0.2f - 0.4f));
+		world.runToRest();
+	}
+	g_sink = world.balls().x[0];
+	state.setItemsPerIteration(1);
+}
+
+// the same shots asked for again and again, as a player re-aiming around
+// a few spots would: 32 aims, each off by less than half a cache step
+// every time. only the first round plays the shots
+static void benchShotCache(BenchState& state)
+{
+	state.pause();
+	World table;
+	rackTable(table, state.arg());
+	table.setSolver(World::EVENT_DRIVEN);
+	ShotCache cache;
+	state.resume();
+
+	Real sink = 0;
+	for (long long k = 0; k < state.iterations(); k++) {
+		float angle = (float)(k % 32) * (6.2831853f / 32);
+		float jitter = 0.004f * randomUnit();
+		Vec2 v(4 * cosf(angle), 4 * sinf(angle));
+		v.x = std::floor(v.x / (Real)0.01 + (Real)0.5) * (Real)0.01 + jitter;
+		const ShotPrediction& p = cache.predict(table, 0, v);
+		sink += p.finalCenter(0).x;
+	}
+	g_sink = sink;
+	state.setItemsPerIteration(1);
+}
+
+// cue velocities of a batch of candidate strokes, as the shot search
+// launches them
+static void benchLaunch(BenchState& state)
+{
+	state.pause();
+	int n = state.arg();
+	std::vector<Real> dirX(n), dirZ(n), power(n), vx(n), vz(n);
+	for (int i = 0; i < n; i++) {
+		dirX[i] = randomUnit();
+		dirZ[i] = randomUnit();
+		power[i] = 4 + 2 * randomUnit();
+	}
+	state.resume();
+
+	for (long long k = 0; k < state.iterations(); k++)
+		launchVelocities(&dirX[0], &dirZ[0], &power[0], n, &vx[0], &vz[0]);
+	g_sink = vx[n - 1];
+	state.setItemsPerIteration(n);
+}
+
+// the aim preview, worked out again on every mouse move while aiming.
+// it has to stay well inside a millisecond
+static void benchPreview(BenchState& state)
+{
+	state.pause();
+	World table;
+	rackTable(table, state.arg());
+	ShotPreview preview;
+	state.resume();
+
+	Real sink = 0;
+	for (long long k = 0; k < state.iterations(); k++) {
+		float angle = (float)(k % 256) * (6.2831853f / 256);
+		previewShot(table, 0, Vec2(4 * cosf(angle), 4 * sinf(angle)), preview);
+		sink += preview.cue.points[preview.cue.count - 1].x;
+	}
+	g_sink = sink;
+	state.setItemsPerIteration(1);
+}
+
+// switching a test table to another scenario: map a scene file, set up
+// the table from it and let it go again
+static void benchSceneLoad(BenchState& state)
+{
+	const char* path = "physicsBench.vlsc";
+	state.pause();
+	World table;
+	rackTable(table, state.arg());
+	std::string text = "box 0 3.06 9 0.12\nbox 0 -3.06 9 0.12\nbox 4.56 0 0.12 6.24\nbox -4.56 0 0.12 6.24\n"
+		"polygon -0.5 -0.5 0.5 -0.5 0 0.5\n";
+	for (int i = 0; i < table.ballCount(); i++) {
+		char line[64];
+		snprintf(line, sizeof(line), "ball %.4f %.4f\n", (double)table.getCenter(i).x, (double)table.getCenter(i).z);
+		text += line;
+	}
+	std::vector<unsigned char> image;
+	std::string error;
+	FILE* fp = fopen(path, "wb");
+	if (!compileScene(text.c_str(), image, error) || fp == NULL) {
+		fprintf(stderr, "cannot write %s\n", path);
+		exit(1);
+	}
+	fwrite(&image[0], 1, image.size(), fp);
+	fclose(fp);
+	state.resume();
+
+	Scene scene;
+	int sink = 0;
+	for (long long k = 0; k < state.iterations(); k++) {
+		if (scene.open(path)) {
+			scene.apply(table);
+			sink += table.ballCount();
+		}
+		scene.close();
+	}
+	g_sink = (Real)sink;
+	remove(path);
+	state.setItemsPerIteration(1);
+}
+
+// one step of a learning environment: a random shot of the player to
+// shoot played to rest and judged, the table observed after it. arg is
+// the game (rules.h)
+static void benchEnvStep(BenchState& state)
+{
+	state.pause();
+	ShotEnv env((Game)state.arg(), 1 << 30);
+	std::vector<float> observation(env.observationSize());
+	state.resume();
+
+	float sink = 0;
+	for (long long k = 0; k < state.iterations(); k++) {
+		float angle = (float)(k % 64) * (6.2831853f / 64);
+		sink += (float)env.step(4 * cosf(angle), 4 * sinf(angle));
+		env.observe(&observation[0]);
+		sink += observation[0];
+	}
+	g_sink = sink;
+	state.setItemsPerIteration(1);
+}
+
+// one decision of the computer player on every core: a table left by a
+// random shot, searched for a scoring shot. arg is the game (rules.h)
+static void benchShotSearch(BenchState& state)
+{
+	state.pause();
+	ThreadPool pool;
+	ShotSearch search(pool, (Game)state.arg());
+	Table table((Game)state.arg());
+	state.resume();
+
+	Real sink = 0;
+	for (long long k = 0; k < state.iterations(); k++) {
+		state.pause();
+		float angle = (float)(k % 64) * (6.2831853f / 64);
+		table.restart();
+		table.shoot(5 * cosf(angle), 5 * sinf(angle));
+		while (!table.step(1.0f / 30)) {}
+		state.resume();
+		sink += search.find(table.world(), table.cueBall()).velocity.x;
+	}
+	g_sink = sink;
+	state.setItemsPerIteration(1);
+}
+
+// playback of a recording: the balls at a random time, as when scrubbing
+// a review. arg is the shots recorded one after another, so the cost is
+// seen not to grow with the length of the recording
+static void benchTrajectorySeek(BenchState& state)
+{
+	state.pause();
+	Table table;
+	TrajectoryWriter writer;
+	writer.begin(table.world(), FOUR_BALL, table.world().getFixedStep());
+	unsigned int last = table.world().stepIndex();
+	for (int k = 0; k < state.arg(); k++) {
+		float angle = (float)(k % 64) * (6.2831853f / 64);
+		table.shoot(6 * cosf(angle), 6 * sinf(angle));
+		bool ended;
+		do {
+			ended = table.step(1.0f / 120);
+			writer.add(table.world(), (int)(table.world().stepIndex() - last));
+			last = table.world().stepIndex();
+		} while (!ended);
+	}
+	const std::vector<unsigned char>& image = writer.finish();
+	Trajectory review;
+	if (!review.view(&image[0], image.size())) {
+		fprintf(stderr, "cannot read back the recording\n");
+		exit(1);
+	}
+	state.resume();
+
+	float centers[2 * Table::MAX_BALLS], sink = 0;
+	unsigned int r = 12345;
+	for (long long k = 0; k < state.iterations(); k++) {
+		r = r * 1664525u + 1013904223u;
+		review.at(review.duration() * (r >> 8) / (1 << 24), centers);
+		sink += centers[0];
+	}
+	g_sink = sink;
+	state.setItemsPerIteration(1);
+}
+
+static std::vector<Benchmark> allBenchmarks(void)
+{
+	const int counts[] = { 4, 16, 64, 256, 1024, 4096, 10000 };
+	// bigger racks take seconds per shot, the event count grows with every ball
+	const int shotCounts[] = { 4, 16, 64 };
+	const int segmentCounts[] = { 16, 64, 256, 1024, 4096 };
+	const int sceneCounts[] = { 4, 64, 1024 };
+	const int games[] = { FOUR_BALL, THREE_CUSHION };
+	const int recordedShots[] = { 1, 16, 256 };
+
+	std::vector<Benchmark> list;
+	Benchmark integrateB("integrate", "ns/ball-step", true, benchIntegrate);
+	Benchmark rigidB("integrateRigid", "ns/ball-step", true, benchIntegrateRigid);
+	Benchmark cushionB("Cushions::collide", "ns/ball-step", true, benchCushionCollide);
+	Benchmark layoutB("Cushions::layout", "ns/ball-step", true, benchCushionLayout);
+	Benchmark ballB("World::hitBy", "ns/pair", true, benchBallHitBy);
+	Benchmark stepB("World::tick", "ns/ball-step", true, benchStep);
+	Benchmark sparseB("World::tick/sparse", "ns/step", true, benchSparseStep);
+	Benchmark shotB("shotToRest", "shots/sec", false, benchShotToRest);
+	Benchmark rigidShotB("shotToRest/rigid", "shots/sec", false, benchShotToRestRigid);
+	Benchmark cacheB("ShotCache::predict", "shots/sec", false, benchShotCache);
+	Benchmark previewB("previewShot", "ns/preview", true, benchPreview);
+	Benchmark launchB("launchVelocities", "ns/shot", true, benchLaunch);
+	Benchmark sceneB("Scene::open", "loads/sec", false, benchSceneLoad);
+	Benchmark envB("ShotEnv::step", "shots/sec", false, benchEnvStep);
+	Benchmark searchB("ShotSearch::find", "decisions/sec", false, benchShotSearch);
+	Benchmark seekB("Trajectory::at", "ns/seek", true, benchTrajectorySeek);
+	Benchmark* scaled[] = { &integrateB, &rigidB, &cushionB, &ballB, &stepB };
+	for (int b = 0; b < 5; b++) {
+		scaled[b]->args.assign(counts, counts + sizeof(counts) / sizeof(counts[0]));
+		list.push_back(*scaled[b]);
+	}
+	sparseB.args.assign(counts, counts + sizeof(counts) / sizeof(counts[0]));
+	list.push_back(sparseB);
+	layoutB.args.assign(segmentCounts, segmentCounts + sizeof(segmentCounts) / sizeof(segmentCounts[0]));
+	list.push_back(layoutB);
+	shotB.args.assign(shotCounts, shotCounts + sizeof(shotCounts) / sizeof(shotCounts[0]));
+	list.push_back(shotB);
+	rigidShotB.args = shotB.args;
+	list.push_back(rigidShotB);
+	cacheB.args = shotB.args;
+	list.push_back(cacheB);
+	previewB.args.assign(counts, counts + sizeof(counts) / sizeof(counts[0]));
+	list.push_back(previewB);
+	launchB.args.assign(counts, counts + sizeof(counts) / sizeof(counts[0]));
+	list.push_back(launchB);
+	sceneB.args.assign(sceneCounts, sceneCounts + sizeof(sceneCounts) / sizeof(sceneCounts[0]));
+	list.push_back(sceneB);
+	envB.args.assign(games, games + sizeof(games) / sizeof(games[0]));
+	list.push_back(envB);
+	searchB.args = envB.args;
+	list.push_back(searchB);
+	seekB.args.assign(recordedShots, recordedShots + sizeof(recordedShots) / sizeof(recordedShots[0]));
+	list.push_back(seekB);
+	return list;
+}
+
+// ----- output -----
+
+// time per iteration of every benchmark in the --json output of an
+// earlier run. only reads what printJson() writes
+static std::map<std::string, double> loadBaseline(const char* path)
+{
+	std::map<std::string, double> times;
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "cannot open baseline %s\n", path);
+		return times;
+	}
+	char line[256], name[128] = "";
+	while (fgets(line, sizeof(line), f)) {
+		double t;
+		const char* p;
+		if ((p = strstr(line, "\"name\": \"")) != NULL) {
+			p += 9;
+			size_t len = strcspn(p, "\"");
+			if (len >= sizeof(name))
+				len = sizeof(name) - 1;
+			memcpy(name, p, len);
+			name[len] = 0;
+		}
+		else if ((p = strstr(line, "\"real_time\": ")) != NULL && sscanf(p + 13, "%lf", &t) == 1 && name[0])
+			times[name] = t;
+	}
+	fclose(f);
+	return times;
+}
+
+static void printTableHeader(bool baseline)
+{
+	printf("%-24s %14s %12s %16s%s\n", "Benchmark", "Time/iter", "Iterations", "Rate", baseline ? "    Speedup" : "");
+	printf("--------------------------------------------------------------------%s\n", baseline ? "-----------" : "");
+}
+
+static void printTableRow(const BenchResult& r, const std::map<std::string, double>& baseline)
+{
+	char rate[64];
+	snprintf(rate, sizeof(rate), "%.4g %s", r.rate, r.rateName);
+	printf("%-24s %11.0f ns %12lld %16s", r.name.c_str(), r.nsPerIteration, r.iterations, rate);
+	if (!baseline.empty()) {
+		std::map<std::string, double>::const_iterator it = baseline.find(r.name);
+		if (it != baseline.end() && r.nsPerIteration > 0)
+			printf(" %9.2fx", it->second / r.nsPerIteration);
+		else
+			printf(" %10s", "-");
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+static void printJson(const std::vector<BenchResult>& results)
+{
+	printf("{\n  \"context\": {\n");
+	printf("    \"library\": \"physicsBench\",\n");
+	printf("    \"real\": \"%s\",\n", realName());
+#if defined(SIM_DOUBLE)
+	printf("    \"integrate_kernel\": \"scalar\"\n");
+#elif defined(__AVX__)
+	printf("    \"integrate_kernel\": \"avx\"\n");
+#elif defined(__SSE2__) || defined(_M_X64)
+	printf("    \"integrate_kernel\": \"sse2\"\n");
+#else
+	printf("    \"integrate_kernel\": \"scalar\"\n");
+#endif
+	printf("  },\n  \"benchmarks\": [\n");
+	for (size_t k = 0; k < results.size(); k++) {
+		const BenchResult& r = results[k];
+		printf("    {\n");
+		printf("      \"name\": \"%s\",\n", r.name.c_str());
+		printf("      \"iterations\": %lld,\n", r.iterations);
+		printf("      \"real_time\": %.3f,\n", r.nsPerIteration);
+		printf("      \"time_unit\": \"ns\",\n");
+		if (strcmp(r.rateName, "shots/sec") == 0)
+			printf("      \"shots_per_second\": %.3f\n", r.rate);
+		else if (strcmp(r.rateName, "loads/sec") == 0)
+			printf("      \"loads_per_second\": %.3f\n", r.rate);
+		else if (strcmp(r.rateName, "decisions/sec") == 0)
+			printf("      \"decisions_per_second\": %.3f\n", r.rate);
+		else if (strcmp(r.rateName, "ns/pair") == 0)
+			printf("      \"ns_per_pair\": %.4f\n", r.rate);
+		else if (strcmp(r.rateName, "ns/step") == 0)
+			printf("      \"ns_per_step\": %.4f\n", r.rate);
+		else if (strcmp(r.rateName, "ns/preview") == 0)
+			printf("      \"ns_per_preview\": %.4f\n", r.rate);
+		else if (strcmp(r.rateName, "ns/shot") == 0)
+			printf("      \"ns_per_shot\": %.4f\n", r.rate);
+		else if (strcmp(r.rateName, "ns/seek") == 0)
+			printf("      \"ns_per_seek\": %.4f\n", r.rate);
+		else
+			printf("      \"ns_per_ball_step\": %.4f\n", r.rate);
+		printf("    }%s\n", k + 1 < results.size() ? "," : "");
+	}
+	printf("  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+	bool json = false;
+	const char* filter = "";
+	double minTime = 0.5;
+	std::map<std::string, double> baseline;
+
+	for (int a = 1; a < argc; a++) {
+		if (strcmp(argv[a], "--json") == 0)
+			json = true;
+		else if (strncmp(argv[a], "--filter=", 9) == 0)
+			filter = argv[a] + 9;
+		else if (strncmp(argv[a], "--min-time=", 11) == 0)
+			minTime = atof(argv[a] + 11);
+		else if (strncmp(argv[a], "--baseline=", 11) == 0)
+			baseline = loadBaseline(argv[a] + 11);
+		else {
+			fprintf(stderr, "usage: %s [--json] [--filter=<substring>] [--min-time=<seconds>] [--baseline=<file.json>]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	std::vector<Benchmark> list = allBenchmarks();
+	std::vector<BenchResult> results;
+	if (!json)
+		printTableHeader(!baseline.empty());
+	for (size_t b = 0; b < list.size(); b++) {
+		for (size_t a = 0; a < list[b].args.size(); a++) {
+			char name[128];
+			snprintf(name, sizeof(name), "%s/%d", list[b].name, list[b].args[a]);
+			if (strstr(name, filter) == NULL)
+				continue;
+			results.push_back(runBenchmark(list[b], list[b].args[a], minTime));
+			if (!json)
+				printTableRow(results.back(), baseline);
+		}
+	}
+	if (json)
+		printJson(results);
+	return 0;
+}
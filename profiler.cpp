@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: profiler.cpp
+//
+// Hot-path instrumentation. See profiler.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "profiler.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+namespace sim
+{
+	static thread_local Profiler* t_current = NULL;
+
+	static double clockUs(void)
+	{
+		using namespace std::chrono;
+		return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	Profiler::Profiler(void)
+	{
+		m_origin = clockUs();
+		m_frameStart = 0;
+		m_frames = 0;
+		m_slotCount = 0;
+		m_tracing = false;
+		memset(m_frameTimes, 0, sizeof(m_frameTimes));
+	}
+
+	Profiler* Profiler::current(void) { return t_current; }
+	void Profiler::bind(void) { t_current = this; }
+	void Profiler::unbind(void) { if (t_current == this) t_current = NULL; }
+
+	double Profiler::now(void) const
+	{
+		return clockUs() - m_origin;
+	}
+
+	Profiler::Slot* Profiler::slot(const char* name, bool isScope)
+	{
+		// names are string literals, so the pointer is enough in the common case
+		for (int i = 0; i < m_slotCount; i++) {
+			if (m_slots[i].name == name || strcmp(m_slots[i].name, name) == 0)
+				return &m_slots[i];
+		}
+		if (m_slotCount == MAX_SLOTS)
+			return NULL;
+		Slot& s = m_slots[m_slotCount++];
+		s.name = name;
+		s.isScope = isScope;
+		s.frameTotal = 0;
+		memset(s.history, 0, sizeof(s.history));
+		return &s;
+	}
+
+	const Profiler::Slot* Profiler::findSlot(const char* name) const
+	{
+		for (int i = 0; i < m_slotCount; i++) {
+			if (strcmp(m_slots[i].name, name) == 0)
+				return &m_slots[i];
+		}
+		return NULL;
+	}
+
+	void Profiler::beginFrame(void)
+	{
+		m_frameStart = now();
+	}
+
+	void Profiler::endFrame(void)
+	{
+		double end = now();
+		int at = m_frames % WINDOW;
+		m_frameTimes[at] = (end - m_frameStart) / 1000.0;
+		for (int i = 0; i < m_slotCount; i++) {
+			Slot& s = m_slots[i];
+			s.history[at] = s.frameTotal;
+			if (m_tracing && !s.isScope && m_trace.size() < MAX_TRACE_EVENTS) {
+				TraceEvent e = { s.name, end, s.frameTotal, false };
+				m_trace.push_back(e);
+			}
+			s.frameTotal = 0;
+		}
+		m_frames++;
+	}
+
+	void Profiler::addScope(const char* name, double startUs, double durationUs)
+	{
+		Slot* s = slot(name, true);
+		if (s != NULL)
+			s->frameTotal += durationUs / 1000.0;
+		if (m_tracing && m_trace.size() < MAX_TRACE_EVENTS) {
+			TraceEvent e = { name, startUs, durationUs, true };
+			m_trace.push_back(e);
+		}
+	}
+
+	void Profiler::count(const char* name, double value)
+	{
+		Slot* s = slot(name, false);
+		if (s != NULL)
+			s->frameTotal += value;
+	}
+
+	double Profiler::framePercentile(double p) const
+	{
+		int n = frameCount();
+		if (n == 0)
+			return 0;
+		double sorted[WINDOW];
+		memcpy(sorted, m_frameTimes, n * sizeof(double));
+		int k = std::min(n - 1, std::max(0, (int)(p / 100.0 * n)));
+		std::nth_element(sorted, sorted + k, sorted + n);
+		return sorted[k];
+	}
+
+	double Profiler::average(const char* name) const
+	{
+		const Slot* s = findSlot(name);
+		int n = frameCount();
+		if (s == NULL || n == 0)
+			return 0;
+		double sum = 0;
+		for (int i = 0; i < n; i++)
+			sum += s->history[i];
+		return sum / n;
+	}
+
+	int Profiler::formatOverlay(char* buf, int size) const
+	{
+		int len = snprintf(buf, size, "frame  p50 %.2f ms  p99 %.2f ms  (%d frames)\n",
+			framePercentile(50), framePercentile(99), frameCount());
+		for (int i = 0; i < m_slotCount && len < size; i++) {
+			const Slot& s = m_slots[i];
+			len += snprintf(buf + len, size - len, s.isScope ? "%-16s %8.3f ms\n" : "%-16s %8.1f\n",
+				s.name, average(s.name));
+		}
+		return std::min(len, size - 1);
+	}
+
+	bool Profiler::writeChromeTrace(const char* path) const
+	{
+		const Profiler* self = this;
+		return writeChromeTrace(path, &self, 1);
+	}
+
+	bool Profiler::writeChromeTrace(const char* path, const Profiler* const* profilers, int count)
+	{
+		FILE* fp = fopen(path, "w");
+		if (fp == NULL)
+			return false;
+		fprintf(fp, "{\"traceEvents\":[\n");
+		const char* sep = "";
+		for (int k = 0; k < count; k++) {
+			const Profiler& p = *profilers[k];
+			double shift = p.m_origin - profilers[0]->m_origin;
+			for (size_t i = 0; i < p.m_trace.size(); i++) {
+				const TraceEvent& e = p.m_trace[i];
+				if (e.isScope)
+					fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+						sep, e.name, e.start + shift, e.value, k + 1);
+				else
+					fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%g}}",
+						sep, e.name, e.start + shift, k + 1, e.value);
+				sep = ",\n";
+			}
+		}
+		fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+		return fclose(fp) == 0;
+	}
+}
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: profiler.h
+//
+// Hot-path instrumentation for the game and the headless tools.
+// PROFILE_SCOPE("name") times the rest of the enclosing block and
+// PROFILE_COUNT("name", n) adds to a per-frame counter, both into the
+// Profiler bound to the calling thread. Threads without one (the batch
+// workers, for instance) pay a single thread-local load per scope.
+// The profiler keeps a rolling window of frames for the overlay
+// (frame time percentiles, per-scope and per-counter averages) and can
+// keep every scope as a Chrome trace (chrome://tracing, Perfetto).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __profilerH__
+#define __profilerH__
+
+#include <cstddef>
+#include <vector>
+
+namespace sim
+{
+	class Profiler {
+	public:
+		enum { WINDOW = 256, MAX_SLOTS = 32, MAX_TRACE_EVENTS = 1 << 20 };
+
+		Profiler(void);
+
+		// profiler bound to the calling thread, or NULL
+		static Profiler* current(void);
+		void bind(void);
+		void unbind(void);
+
+		// keep every scope and counter for writeChromeTrace()
+		void setTracing(bool on) { m_tracing = on; }
+
+		void beginFrame(void);
+		void endFrame(void);
+
+		// microseconds since the profiler was created
+		double now(void) const;
+
+		void addScope(const char* name, double startUs, double durationUs);
+		void count(const char* name, double value);
+
+		// frame time in ms at percentile p (0..100) over the rolling window
+		double framePercentile(double p) const;
+		// average per frame over the window of a scope (ms) or counter
+		double average(const char* name) const;
+		int frameCount(void) const { return m_frames < WINDOW ? m_frames : WINDOW; }
+
+		// one line per entry: frame percentiles, then every scope and counter
+		int formatOverlay(char* buf, int size) const;
+		bool writeChromeTrace(const char* path) const;
+		// one trace of the scopes of several profilers, each on a thread row
+		// of its own in the order given, on the clock of the first
+		static bool writeChromeTrace(const char* path, const Profiler* const* profilers, int count);
+
+	private:
+		struct Slot {
+			const char*     name;
+			bool            isScope;
+			double          frameTotal;
+			double          history[WINDOW];
+		};
+
+		struct TraceEvent {
+			const char*     name;
+			double          start;      // us
+			double          value;      // duration (us) of a scope, or counter value
+			bool            isScope;
+		};
+
+		Slot* slot(const char* name, bool isScope);
+		const Slot* findSlot(const char* name) const;
+
+		double                  m_origin;
+		double                  m_frameStart;
+		double                  m_frameTimes[WINDOW];   // ms
+		int                     m_frames;
+		Slot                    m_slots[MAX_SLOTS];
+		int                     m_slotCount;
+		bool                    m_tracing;
+		std::vector<TraceEvent> m_trace;
+	};
+
+	// times the enclosing block into the thread's profiler
+	class ProfileScope {
+	public:
+		explicit ProfileScope(const char* name)
+			: m_profiler(Profiler::current()), m_name(name), m_start(0)
+		{
+			if (m_profiler != NULL)
+				m_start = m_profiler->now();
+		}
+		~ProfileScope(void)
+		{
+			if (m_profiler != NULL)
+				m_profiler->addScope(m_name, m_start, m_profiler->now() - m_start);
+		}
+
+	private:
+		Profiler*       m_profiler;
+		const char*     m_name;
+		double          m_start;
+	};
+}
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) sim::ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define PROFILE_COUNT(name, value) \
+	do { if (sim::Profiler* p_ = sim::Profiler::current()) p_->count((name), (value)); } while (0)
+
+#endif // __profilerH__
@@ -0,0 +1,29 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: real.h
+//
+// Scalar type of the ball state and of everything the physics computes
+// from it. float by default; build with SIM_DOUBLE defined to run the whole
+// table in double, for checking how much float rounding moves a shot. The
+// SIMD kernels are float only and give way to their scalar versions then.
+// Inputs from outside the table (rack positions, cushion geometry,
+// TableInputs, replays) stay float either way.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __realH__
+#define __realH__
+
+namespace sim
+{
+#if defined(SIM_DOUBLE)
+	typedef double Real;
+#else
+	typedef float Real;
+#endif
+
+	// name of Real, for benchmark and log output
+	inline const char* realName(void) { return sizeof(Real) == sizeof(double) ? "double" : "float"; }
+}
+
+#endif // __realH__
@@ -0,0 +1,299 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: replay.cpp
+//
+// Binary replay recording and headless re-simulation. See replay.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "replay.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace sim
+{
+	static const char REPLAY_MAGIC[4] = { 'V', 'L', 'R', 'P' };
+	static const unsigned short REPLAY_VERSION = 1;
+	// longest recording verify() plays: a day of play at 120 steps a second
+	static const unsigned int MAX_REPLAY_STEPS = 24 * 3600 * 120;
+
+	// -------------------------------------------------------------------------
+	// little endian byte helpers
+	// -------------------------------------------------------------------------
+
+	static void putU8(std::vector<unsigned char>& out, unsigned int v) { out.push_back((unsigned char)v); }
+	static void putU16(std::vector<unsigned char>& out, unsigned int v) { putU8(out, v & 0xff); putU8(out, (v >> 8) & 0xff); }
+	static void putU32(std::vector<unsigned char>& out, unsigned int v) { putU16(out, v & 0xffff); putU16(out, v >> 16); }
+	static void putF32(std::vector<unsigned char>& out, float f)
+	{
+		unsigned int v;
+		memcpy(&v, &f, 4);
+		putU32(out, v);
+	}
+
+	struct Reader {
+		const unsigned char*    p;
+		const unsigned char*    end;
+
+		bool has(size_t n) const { return (size_t)(end - p) >= n; }
+		unsigned int u8(void) { return *p++; }
+		unsigned int u16(void) { unsigned int v = u8(); return v | (u8() << 8); }
+		unsigned int u32(void) { unsigned int v = u16(); return v | (u16() << 16); }
+		float f32(void)
+		{
+			unsigned int v = u32();
+			float f;
+			memcpy(&f, &v, 4);
+			return f;
+		}
+	};
+
+	// -------------------------------------------------------------------------
+	// Replay
+	// -------------------------------------------------------------------------
+
+	Replay::Replay(void)
+	{
+		m_solver = World::FIXED_STEP;
+		m_fixedStep = 0;
+		m_whiteTurn = true;
+		m_game = FOUR_BALL;
+		m_baseStep = 0;
+	}
+
+	void Replay::begin(const World& world, bool whiteTurn, Game game)
+	{
+		m_solver = world.getSolver();
+		m_fixedStep = world.getFixedStep();
+		m_whiteTurn = whiteTurn;
+		m_game = game;
+		m_baseStep = world.stepIndex();
+		m_initial.resize(2 * world.ballCount());
+		for (int i = 0; i < world.ballCount(); i++) {
+			m_initial[2 * i] = (float)world.getCenter(i).x;
+			m_initial[2 * i + 1] = (float)world.getCenter(i).z;
+		}
+		m_inputs.clear();
+	}
+
+	Replay::Input Replay::makeInput(const World& world, InputType type) const
+	{
+		Input in;
+		memset(&in, 0, sizeof(in));
+		in.step = world.stepIndex() - m_baseStep;
+		in.type = (unsigned char)type;
+		return in;
+	}
+
+	void Replay::addCue(const World& world, int ball, float vx, float vz)
+	{
+		Input in = makeInput(world, INPUT_CUE);
+		in.a = (unsigned char)ball;
+		in.vx = vx;
+		in.vz = vz;
+		m_inputs.push_back(in);
+	}
+
+	void Replay::addTurn(const World& world)
+	{
+		m_inputs.push_back(makeInput(world, INPUT_TURN));
+	}
+
+	void Replay::addReset(const World& world)
+	{
+		m_inputs.push_back(makeInput(world, INPUT_RESET));
+	}
+
+	void Replay::addShotEnd(const World& world, bool whiteTurn, int wScore, int yScore)
+	{
+		Input in = makeInput(world, INPUT_SHOT_END);
+		in.whiteTurn = whiteTurn ? 1 : 0;
+		in.wScore = (short)wScore;
+		in.yScore = (short)yScore;
+		m_inputs.push_back(in);
+	}
+
+	bool Replay::save(const char* path) const
+	{
+		std::vector<unsigned char> out;
+		size_t i;
+
+		out.insert(out.end(), REPLAY_MAGIC, REPLAY_MAGIC + 4);
+		putU16(out, REPLAY_VERSION);
+		putU8(out, m_solver);
+		putU8(out, (unsigned int)(m_initial.size() / 2));
+		putF32(out, m_fixedStep);
+		putU8(out, m_whiteTurn ? 1 : 0);
+		putU8(out, m_game);
+		putU8(out, 0);   putU8(out, 0);
+		for (i = 0; i < m_initial.size(); i++)
+			putF32(out, m_initial[i]);
+
+		putU32(out, (unsigned int)m_inputs.size());
+		for (i = 0; i < m_inputs.size(); i++) {
+			const Input& in = m_inputs[i];
+			putU32(out, in.step);
+			putU8(out, in.type);   putU8(out, in.a);   putU8(out, in.b);   putU8(out, in.whiteTurn);
+			putF32(out, in.vx);
+			putF32(out, in.vz);
+			putU16(out, (unsigned short)in.wScore);
+			putU16(out, (unsigned short)in.yScore);
+		}
+
+		FILE* fp = fopen(path, "wb");
+		if (fp == NULL)
+			return false;
+		bool ok = fwrite(&out[0], 1, out.size(), fp) == out.size();
+		return fclose(fp) == 0 && ok;
+	}
+
+	bool Replay::load(const char* path)
+	{
+		FILE* fp = fopen(path, "rb");
+		if (fp == NULL)
+			return false;
+		std::vector<unsigned char> data;
+		unsigned char buf[4096];
+		size_t got;
+		while ((got = fread(buf, 1, sizeof(buf), fp)) > 0)
+			data.insert(data.end(), buf, buf + got);
+		fclose(fp);
+
+		if (data.size() < 16 || memcmp(&data[0], REPLAY_MAGIC, 4) != 0)
+			return false;
+		Reader r = { &data[0] + 4, &data[0] + data.size() };
+		if (r.u16() != REPLAY_VERSION)
+			return false;
+		unsigned int solver = r.u8();
+		unsigned int ballCount = r.u8();
+		float fixedStep = r.f32();
+		bool whiteTurn = r.u8() != 0;
+		// older recordings have padding here, which reads as four-ball
+		unsigned int game = r.u8();
+		r.p += 2;
+
+		// a replay is evidence of a game, so nothing in it is trusted: verify()
+		// hands the balls and steps to World as they are
+		if (game >= GAME_COUNT || (int)ballCount != rulesFor((Game)game).ballCount())
+			return false;
+		if (solver != World::FIXED_STEP && solver != World::EVENT_DRIVEN)
+			return false;
+		if (!(fixedStep > 0) || !std::isfinite(fixedStep))
+			return false;
+
+		if (!r.has(ballCount * 8 + 4))
+			return false;
+		std::vector<float> initial(ballCount * 2);
+		for (size_t i = 0; i < initial.size(); i++) {
+			initial[i] = r.f32();
+			if (!std::isfinite(initial[i]))
+				return false;
+		}
+
+		unsigned int count = r.u32();
+		if (!r.has((size_t)count * 20))
+			return false;
+		std::vector<Input> inputs(count);
+		bool shotPending = false;
+		for (unsigned int k = 0; k < count; k++) {
+			Input& in = inputs[k];
+			in.step = r.u32();
+			in.type = (unsigned char)r.u8();   in.a = (unsigned char)r.u8();
+			in.b = (unsigned char)r.u8();      in.whiteTurn = (unsigned char)r.u8();
+			in.vx = r.f32();
+			in.vz = r.f32();
+			in.wScore = (short)r.u16();
+			in.yScore = (short)r.u16();
+
+			if (in.step > MAX_REPLAY_STEPS || (k > 0 && in.step < inputs[k - 1].step))
+				return false;
+			switch (in.type) {
+			case INPUT_CUE:
+				if (in.a >= ballCount || !std::isfinite(in.vx) || !std::isfinite(in.vz))
+					return false;
+				shotPending = true;
+				break;
+			case INPUT_SWAP:
+				if (in.a >= ballCount || in.b >= ballCount)
+					return false;
+				break;
+			case INPUT_TURN:
+				break;
+			case INPUT_RESET:
+				shotPending = false;
+				break;
+			case INPUT_SHOT_END:
+				// only a shot played can be judged
+				if (!shotPending)
+					return false;
+				shotPending = false;
+				break;
+			default:
+				return false;
+			}
+		}
+
+		m_solver = (World::Solver)solver;
+		m_fixedStep = fixedStep;
+		m_whiteTurn = whiteTurn;
+		m_game = (Game)game;
+		m_baseStep = 0;
+		m_initial.swap(initial);
+		m_inputs.swap(inputs);
+		return true;
+	}
+
+	bool Replay::verify(World& world) const
+	{
+		const Rules& rules = rulesFor(m_game);
+		int ballCount = (int)m_initial.size() / 2;
+		bool whiteTurn = m_whiteTurn;
+		int wScore = 0, yScore = 0, cueBall = -1;
+
+		world.setSolver(m_solver);
+		world.setFixedStep(m_fixedStep);
+		world.reset((const float(*)[2])&m_initial[0], ballCount);
+		unsigned int base = world.stepIndex();
+
+		for (size_t k = 0; k < m_inputs.size(); k++) {
+			const Input& in = m_inputs[k];
+			while (world.stepIndex() - base < in.step)
+				world.tick();
+
+			switch (in.type) {
+			case INPUT_CUE:
+				world.clearContacts();
+				world.setPower(in.a, in.vx, in.vz);
+				cueBall = in.a;
+				break;
+			case INPUT_SWAP:
+				world.swapBalls(in.a, in.b);
+				whiteTurn = !whiteTurn;
+				break;
+			case INPUT_TURN:
+				whiteTurn = !whiteTurn;
+				break;
+			case INPUT_RESET:
+				world.reset((const float(*)[2])&m_initial[0], ballCount);
+				whiteTurn = true;
+				wScore = yScore = 0;
+				break;
+			case INPUT_SHOT_END: {
+				int points = rules.judge(world.contacts(), cueBall).points;
+				if (whiteTurn)
+					wScore += points;
+				else
+					yScore += points;
+				world.clearContacts();
+				if ((in.whiteTurn != 0) != whiteTurn || in.wScore != wScore || in.yScore != yScore)
+					return false;
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+		return true;
+	}
+}
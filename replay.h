@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: replay.h
+//
+// Compact binary replay of a game: the initial ball centers, every cue input
+// and the turn/score state after every shot, each stamped with the fixed step
+// it happened at. Replaying needs no window or device; the table is stepped
+// headlessly as fast as the CPU allows, and verify() checks that every
+// recorded score comes out the same again.
+//
+// Layout (little endian):
+//     char[4] "VLRP", u16 version, u8 solver, u8 ballCount, f32 fixedStep,
+//     u8 whiteTurn, u8 game, u8[2] padding, f32[ballCount][2] initial centers,
+//     u32 inputCount, inputCount * 20-byte Input records
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __replayH__
+#define __replayH__
+
+#include "billiardSim.h"
+#include "rules.h"
+
+namespace sim
+{
+	class Replay {
+	public:
+		enum InputType {
+			INPUT_CUE = 1,     // ball a is struck with (vx, vz)
+			INPUT_SWAP,        // balls a and b are swapped and the turn passes (older recordings)
+			INPUT_RESET,       // balls back to their initial centers, scores cleared
+			INPUT_SHOT_END,    // all balls stopped; turn and scores after scoring
+			INPUT_TURN         // the turn passes to the other player
+		};
+
+		struct Input {
+			unsigned int    step;         // fixed steps since begin()
+			unsigned char   type;         // InputType
+			unsigned char   a, b;
+			unsigned char   whiteTurn;
+			float           vx, vz;
+			short           wScore, yScore;
+		};
+
+		Replay(void);
+
+		// start a recording of game from the current table. world must be
+		// in fixed-step mode
+		void begin(const World& world, bool whiteTurn, Game game = FOUR_BALL);
+
+		void addCue(const World& world, int ball, float vx, float vz);
+		void addTurn(const World& world);
+		void addReset(const World& world);
+		void addShotEnd(const World& world, bool whiteTurn, int wScore, int yScore);
+
+		int inputCount(void) const { return (int)m_inputs.size(); }
+		const Input& input(int k) const { return m_inputs[k]; }
+
+		bool save(const char* path) const;
+		// false, leaving the replay as it is, when path cannot be read or
+		// is not a replay verify() can play: the ball count of its game, a
+		// known solver, a positive step, inputs in order on balls that
+		// exist, every shot end after a cue, a day of play at most
+		bool load(const char* path);
+
+		// re-simulate the recording on world, which keeps its cushions,
+		// radius, damping and ball model, and judge every shot by the rules
+		// of the game. returns false as soon as a recorded shot result
+		// differs from the simulated one
+		bool verify(World& world) const;
+
+	private:
+		Input makeInput(const World& world, InputType type) const;
+
+		World::Solver       m_solver;
+		float               m_fixedStep;
+		bool                m_whiteTurn;
+		Game                m_game;
+		unsigned int        m_baseStep;
+		std::vector<float>  m_initial;    // x, z of every ball
+		std::vector<Input>  m_inputs;
+	};
+}
+
+#endif // __replayH__
@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: rules.cpp
+//
+// Four-ball and three-cushion. See rules.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "rules.h"
+#include <cstddef>
+#include <cstring>
+
+namespace sim
+{
+	// the ball cueBall touched in contact e, or -1 when e is not one of its
+	// ball-ball contacts
+	static int touchedBy(const ContactEvent& e, int cueBall)
+	{
+		if (e.type != ContactEvent::BALL)
+			return -1;
+		if (e.a == cueBall)
+			return e.b;
+		return e.b == cueBall ? e.a : -1;
+	}
+
+	// -------------------------------------------------------------------------
+	// four-ball
+	// -------------------------------------------------------------------------
+
+	class FourBallRules : public Rules {
+	public:
+		Game game(void) const { return FOUR_BALL; }
+		const char* name(void) const { return "four-ball"; }
+		int ballCount(void) const { return 4; }
+		const float* rack(void) const
+		{
+			static const float RACK[4][2] = { { -2.7f, 0 }, { +2.4f, 0 }, { 3.3f, 0 }, { -2.7f, -1.0f } };
+			return &RACK[0][0];
+		}
+		int cueBall(int player) const { return player == 0 ? 3 : 2; }
+		bool isObjectBall(int ball, int) const { return ball == 0 || ball == 1; }
+
+		ShotOutcome judge(const std::vector<ContactEvent>& contacts, int cueBall) const
+		{
+			int other = cueBall == 3 ? 2 : 3;
+			bool red0 = false, red1 = false, foul = false;
+			for (size_t k = 0; k < contacts.size(); k++) {
+				int ball = touchedBy(contacts[k], cueBall);
+				red0 = red0 || ball == 0;
+				red1 = red1 || ball == 1;
+				foul = foul || ball == other;
+			}
+			ShotOutcome r;
+			r.points = foul ? -10 : (red0 && red1 ? 10 : 0);
+			r.keepTurn = r.points > 0;
+			return r;
+		}
+	};
+
+	// -------------------------------------------------------------------------
+	// three-cushion
+	// -------------------------------------------------------------------------
+
+	class ThreeCushionRules : public Rules {
+	public:
+		Game game(void) const { return THREE_CUSHION; }
+		const char* name(void) const { return "three-cushion"; }
+		int ballCount(void) const { return 3; }
+		// red on the foot spot, yellow on the head spot, white beside it
+		const float* rack(void) const
+		{
+			static const float RACK[3][2] = { { 2.25f, 0 }, { -2.25f, 0 }, { -2.25f, -0.5f } };
+			return &RACK[0][0];
+		}
+		int cueBall(int player) const { return player == 0 ? 2 : 1; }
+		bool isObjectBall(int ball, int cueBall) const { return ball != cueBall; }
+
+		// the cushions count up to the contact with the second object
+		// ball, so the events after it are not looked at
+		ShotOutcome judge(const std::vector<ContactEvent>& contacts, int cueBall) const
+		{
+			int first = -1, cushions = 0;
+			ShotOutcome r = { 0, false };
+			for (size_t k = 0; k < contacts.size(); k++) {
+				const ContactEvent& e = contacts[k];
+				if (e.type == ContactEvent::CUSHION) {
+					if (e.a == cueBall)
+						cushions++;
+					continue;
+				}
+				int ball = touchedBy(e, cueBall);
+				if (ball < 0 || ball == first)
+					continue;
+				if (first >= 0) {
+					r.points = cushions >= 3 ? 1 : 0;
+					break;
+				}
+				first = ball;
+			}
+			r.keepTurn = r.points > 0;
+			return r;
+		}
+	};
+
+	const Rules& rulesFor(Game game)
+	{
+		static const FourBallRules fourBall;
+		static const ThreeCushionRules threeCushion;
+		if (game == THREE_CUSHION)
+			return threeCushion;
+		return fourBall;
+	}
+
+	bool gameNamed(const char* name, Game& game)
+	{
+		for (int g = 0; g < GAME_COUNT; g++) {
+			if (strcmp(rulesFor((Game)g).name(), name) == 0) {
+				game = (Game)g;
+				return true;
+			}
+		}
+		return false;
+	}
+}
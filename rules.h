@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: rules.h
+//
+// Rules of the games a Table plays. A shot is judged from the contact
+// events the physics records while it runs (World::contacts()): the balls
+// the cue ball touched, in order, and the cushions it came off in between.
+// Judging is one pass over the events of the shot, and nothing is scanned
+// frame by frame. Each player has a ball of their own, so passing the turn
+// only changes which ball is the cue ball.
+//
+//     FOUR_BALL       balls 0 and 1 red, 2 yellow, 3 white. +10 for
+//                     touching both reds, -10 for touching the other
+//                     player's ball
+//     THREE_CUSHION   ball 0 red, 1 yellow, 2 white. +1 for touching both
+//                     other balls, with three cushions or more before the
+//                     second
+// In both the player shoots again after a shot that scored.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __rulesH__
+#define __rulesH__
+
+#include "billiardSim.h"
+
+namespace sim
+{
+	enum Game { FOUR_BALL, THREE_CUSHION, GAME_COUNT };
+
+	struct ShotOutcome {
+		int             points;     // to the player who shot, may be negative
+		bool            keepTurn;   // the same player shoots again
+	};
+
+	class Rules {
+	public:
+		virtual ~Rules(void) {}
+
+		virtual Game game(void) const = 0;
+		virtual const char* name(void) const = 0;
+
+		// balls of the game, and their opening position on the standard
+		// table: ballCount() pairs (x, z)
+		virtual int ballCount(void) const = 0;
+		virtual const float* rack(void) const = 0;
+		// ball of player 0 (white, who opens) and of player 1 (yellow)
+		virtual int cueBall(int player) const = 0;
+		// whether the player of cueBall plays to touch ball: the reds in
+		// four-ball, both other balls in three-cushion
+		virtual bool isObjectBall(int ball, int cueBall) const = 0;
+
+		// the shot cueBall was struck for, from the contacts it made
+		virtual ShotOutcome judge(const std::vector<ContactEvent>& contacts, int cueBall) const = 0;
+	};
+
+	// rules of game. they hold no state, so one object serves every table
+	const Rules& rulesFor(Game game);
+	// the game called name ("four-ball", "three-cushion"). false if none is
+	bool gameNamed(const char* name, Game& game);
+}
+
+#endif // __rulesH__
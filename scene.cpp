@@ -0,0 +1,316 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: scene.cpp
+//
+// Scene files, mapped and read in place. See scene.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "scene.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sim
+{
+	static const char SCENE_MAGIC[4] = { 'V', 'L', 'S', 'C' };
+	static const unsigned int SCENE_VERSION = 1;
+
+	// -------------------------------------------------------------------------
+	// mapping
+	// -------------------------------------------------------------------------
+
+	// map the whole file at path for reading. NULL when it cannot be read
+	// or is empty
+	static void* mapFile(const char* path, size_t& size)
+	{
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return NULL;
+		LARGE_INTEGER length;
+		void* data = NULL;
+		if (GetFileSizeEx(file, &length) && length.QuadPart > 0 && length.HighPart == 0) {
+			HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping != NULL) {
+				data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(mapping);
+			}
+			size = (size_t)length.QuadPart;
+		}
+		CloseHandle(file);
+		return data;
+#else
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return NULL;
+		struct stat st;
+		void* data = NULL;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+				data = NULL;
+			size = (size_t)st.st_size;
+		}
+		::close(fd);
+		return data;
+#endif
+	}
+
+	static void unmapFile(void* data, size_t size)
+	{
+#if defined(_WIN32)
+		(void)size;
+		UnmapViewOfFile(data);
+#else
+		munmap(data, size);
+#endif
+	}
+
+	// -------------------------------------------------------------------------
+	// Scene
+	// -------------------------------------------------------------------------
+
+	Scene::Scene(void)
+	{
+		m_header = NULL;
+		m_boxes = NULL;
+		m_polygons = NULL;
+		m_points = m_centers = NULL;
+		m_colors = NULL;
+		m_map = NULL;
+		m_mapSize = 0;
+	}
+
+	Scene::~Scene(void)
+	{
+		close();
+	}
+
+	bool Scene::open(const char* path)
+	{
+		close();
+		size_t size = 0;
+		void* data = mapFile(path, size);
+		if (data == NULL)
+			return false;
+		if (!view(data, size)) {
+			unmapFile(data, size);
+			return false;
+		}
+		m_map = data;
+		m_mapSize = size;
+		return true;
+	}
+
+	// the array of count elements of elementSize bytes at offset lies inside
+	// size bytes and is aligned for 4-byte fields
+	static bool holds(size_t size, unsigned int offset, unsigned int count, size_t elementSize)
+	{
+		return offset % 4 == 0 && offset <= size && (unsigned long long)count * elementSize <= size - offset;
+	}
+
+	// only the header and the polygon ranges are checked, which costs the
+	// same for every scene; the arrays are used as they are in the file
+	bool Scene::view(const void* data, size_t size)
+	{
+		close();
+		const SceneHeader* h = (const SceneHeader*)data;
+		if (data == NULL || ((size_t)data & 3) != 0 || size < sizeof(SceneHeader))
+			return false;
+		if (memcmp(h->magic, SCENE_MAGIC, 4) != 0 || h->version != SCENE_VERSION || h->size != size)
+			return false;
+		if (!(h->radius > 0) || !(h->damping > 0))
+			return false;
+		if (!holds(size, h->boxOffset, h->boxCount, sizeof(SceneBox))
+			|| !holds(size, h->polygonOffset, h->polygonCount, sizeof(ScenePolygon))
+			|| !holds(size, h->pointOffset, h->pointCount, sizeof(ScenePoint))
+			|| !holds(size, h->centerOffset, h->ballCount, sizeof(ScenePoint))
+			|| !holds(size, h->colorOffset, h->ballCount, sizeof(unsigned int)))
+			return false;
+
+		const unsigned char* base = (const unsigned char*)data;
+		const ScenePolygon* polygons = (const ScenePolygon*)(base + h->polygonOffset);
+		for (unsigned int k = 0; k < h->polygonCount; k++) {
+			if (polygons[k].count < 2 || polygons[k].first > h->pointCount
+				|| polygons[k].count > h->pointCount - polygons[k].first)
+				return false;
+		}
+
+		m_header = h;
+		m_boxes = (const SceneBox*)(base + h->boxOffset);
+		m_polygons = polygons;
+		m_points = (const ScenePoint*)(base + h->pointOffset);
+		m_centers = (const ScenePoint*)(base + h->centerOffset);
+		m_colors = (const unsigned int*)(base + h->colorOffset);
+		return true;
+	}
+
+	void Scene::close(void)
+	{
+		if (m_map != NULL)
+			unmapFile(m_map, m_mapSize);
+		m_map = NULL;
+		m_mapSize = 0;
+		m_header = NULL;
+		m_boxes = NULL;
+		m_polygons = NULL;
+		m_points = m_centers = NULL;
+		m_colors = NULL;
+	}
+
+	void Scene::applyCushions(Cushions& cushions) const
+	{
+		cushions.clear();
+		for (int k = 0; k < boxCount(); k++) {
+			const SceneBox& b = m_boxes[k];
+			cushions.addBox(b.x, b.z, b.width, b.depth);
+		}
+		for (int k = 0; k < polygonCount(); k++) {
+			int count;
+			const ScenePoint* pts = polygon(k, count);
+			cushions.addPolygon(pts, count);
+		}
+	}
+
+	void Scene::apply(World& world) const
+	{
+		world.setRadius(radius());
+		world.setDamping(damping());
+		applyCushions(world.cushions());
+		world.cushions().build(world.getRadius());
+		world.reset(m_centers, ballCount());
+	}
+
+	// -------------------------------------------------------------------------
+	// text import
+	// -------------------------------------------------------------------------
+
+	static void store(std::vector<unsigned char>& image, unsigned int offset, const void* data, size_t bytes)
+	{
+		if (bytes > 0)
+			memcpy(&image[offset], data, bytes);
+	}
+
+	static bool fail(std::string& error, int line, const char* what)
+	{
+		std::ostringstream s;
+		s << "line " << line << ": " << what;
+		error = s.str();
+		return false;
+	}
+
+	bool compileScene(const char* text, std::vector<unsigned char>& image, std::string& error)
+	{
+		float width = 9, depth = 6;
+		float radius = (float)M_RADIUS, damping = (float)DAMPING;
+		std::vector<float> boxes, points, centers;
+		std::vector<unsigned int> polygons, colors;
+
+		std::istringstream in(text);
+		std::string raw;
+		for (int line = 1; std::getline(in, raw); line++) {
+			size_t hash = raw.find('#');
+			if (hash != std::string::npos)
+				raw.erase(hash);
+			std::istringstream fields(raw);
+			std::string item;
+			if (!(fields >> item))
+				continue;
+
+			std::vector<float> v;
+			float f;
+			std::string word;
+			unsigned int color = 0xffffffffu;
+			if (item == "ball") {
+				// the color is hex, so only the two coordinates are numbers
+				for (int k = 0; k < 2 && fields >> f; k++)
+					v.push_back(f);
+				if (v.size() == 2 && fields >> word) {
+					char* end;
+					color = (unsigned int)strtoul(word.c_str(), &end, 16);
+					if (*end != 0 || (word.size() != 6 && word.size() != 8))
+						return fail(error, line, "color is not rrggbb or rrggbbaa");
+					if (word.size() == 6)
+						color = (color << 8) | 0xff;
+				}
+			}
+			else {
+				while (fields >> f)
+					v.push_back(f);
+			}
+			fields.clear();
+			if (fields >> word)
+				return fail(error, line, "unexpected text");
+
+			if (item == "table" && v.size() == 2 && v[0] > 0 && v[1] > 0) {
+				width = v[0];
+				depth = v[1];
+			}
+			else if (item == "radius" && v.size() == 1 && v[0] > 0)
+				radius = v[0];
+			else if (item == "damping" && v.size() == 1 && v[0] > 0)
+				damping = v[0];
+			else if (item == "box" && v.size() == 4 && v[2] >= 0 && v[3] >= 0)
+				boxes.insert(boxes.end(), v.begin(), v.end());
+			else if (item == "polygon" && v.size() >= 6 && v.size() % 2 == 0) {
+				polygons.push_back((unsigned int)(points.size() / 2));
+				polygons.push_back((unsigned int)(v.size() / 2));
+				points.insert(points.end(), v.begin(), v.end());
+			}
+			else if (item == "ball" && v.size() == 2) {
+				centers.insert(centers.end(), v.begin(), v.end());
+				colors.push_back(color);
+			}
+			else if (item == "table" || item == "radius" || item == "damping" || item == "box"
+				|| item == "polygon" || item == "ball")
+				return fail(error, line, ("bad values for " + item).c_str());
+			else
+				return fail(error, line, ("unknown item " + item).c_str());
+		}
+
+		// arrays in the order of the layout in scene.h, right after the header
+		unsigned int offset = (unsigned int)sizeof(SceneHeader);
+		unsigned int boxOffset = offset;         offset += (unsigned int)(boxes.size() * 4);
+		unsigned int polygonOffset = offset;     offset += (unsigned int)(polygons.size() * 4);
+		unsigned int pointOffset = offset;       offset += (unsigned int)(points.size() * 4);
+		unsigned int centerOffset = offset;      offset += (unsigned int)(centers.size() * 4);
+		unsigned int colorOffset = offset;       offset += (unsigned int)(colors.size() * 4);
+
+		// the file is the header and arrays as the host lays them out, which
+		// is the layout above on a little-endian host
+		SceneHeader h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, SCENE_MAGIC, 4);
+		h.version = SCENE_VERSION;
+		h.size = offset;
+		h.width = width;
+		h.depth = depth;
+		h.radius = radius;
+		h.damping = damping;
+		h.boxCount = (unsigned int)(boxes.size() / 4);         h.boxOffset = boxOffset;
+		h.polygonCount = (unsigned int)(polygons.size() / 2);  h.polygonOffset = polygonOffset;
+		h.pointCount = (unsigned int)(points.size() / 2);      h.pointOffset = pointOffset;
+		h.ballCount = (unsigned int)colors.size();             h.centerOffset = centerOffset;
+		h.colorOffset = colorOffset;
+
+		image.assign(offset, 0);
+		store(image, 0, &h, sizeof(h));
+		store(image, boxOffset, boxes.data(), boxes.size() * 4);
+		store(image, polygonOffset, polygons.data(), polygons.size() * 4);
+		store(image, pointOffset, points.data(), points.size() * 4);
+		store(image, centerOffset, centers.data(), centers.size() * 4);
+		store(image, colorOffset, colors.data(), colors.size() * 4);
+		return true;
+	}
+}
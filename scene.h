@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: scene.h
+//
+// Scene files: the layout and physics of a table in one file, so a new
+// table needs no rebuild. A scene holds the size of the playing surface,
+// the cushions (boxes and closed polygons), every ball with its color, the
+// ball radius and the damping rate.
+// The file is a fixed header and flat arrays of 4-byte fields in the order
+// the simulation takes them, so Scene maps it and reads it in place:
+// opening a scene is one mmap and a check of the header, and applying it
+// hands the arrays straight to Cushions and World. Scene files are written
+// from a text description by compileScene() (see sceneTool.cpp).
+//
+// Layout (little endian, read in place, so little-endian hosts only):
+//     SceneHeader, then at the offsets it gives, each 4-byte aligned:
+//     SceneBox[boxCount]              box cushions, like Cushions::addBox
+//     ScenePolygon[polygonCount]      ranges of the polygon points
+//     f32[pointCount][2]              polygon points (x, z)
+//     f32[ballCount][2]               ball centers (x, z), in rack order
+//     u32[ballCount]                  ball colors, 0xRRGGBBAA
+//
+// Text description, one item per line, # starts a comment:
+//     table <width> <depth>           playing surface, for drawing (9 6)
+//     radius <r>                      ball radius (M_RADIUS)
+//     damping <k>                     slow-down rate in 1/s (DAMPING)
+//     box <x> <z> <width> <depth>     box cushion centered on (x, z)
+//     polygon <x> <z> <x> <z> ...     closed cushion outline, 3 points or more
+//     ball <x> <z> [<rrggbb[aa]>]     a ball at rest (white)
+// The standard four-ball table (Table::RAILS and its rack in rules.h) reads
+//     box 0 3.06 9 0.12
+//     box 0 -3.06 9 0.12
+//     box 4.56 0 0.12 6.24
+//     box -4.56 0 0.12 6.24
+//     ball -2.7 0 ff0000
+//     ball 2.4 0 ff0000
+//     ball 3.3 0 ffff00
+//     ball -2.7 -1 ffffff
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __sceneH__
+#define __sceneH__
+
+#include "billiardSim.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace sim
+{
+	struct SceneHeader {
+		char            magic[4];       // "VLSC"
+		unsigned int    version;
+		unsigned int    size;           // bytes of the whole file
+		float           width, depth;
+		float           radius;
+		float           damping;
+		unsigned int    boxCount, boxOffset;
+		unsigned int    polygonCount, polygonOffset;
+		unsigned int    pointCount, pointOffset;
+		unsigned int    ballCount, centerOffset, colorOffset;
+	};
+
+	struct SceneBox {
+		float           x, z, width, depth;
+	};
+
+	// (x, z), as Cushions::addPolygon and World::reset take points
+	typedef float ScenePoint[2];
+
+	struct ScenePolygon {
+		unsigned int    first, count;   // points first to first + count - 1
+	};
+
+	class Scene {
+	public:
+		Scene(void);
+		~Scene(void);
+
+		// map the scene file at path. false, leaving the scene empty, when it
+		// cannot be read or is not a valid scene
+		bool open(const char* path);
+		// use the size bytes at data as a scene file, without a copy. data
+		// must be 4-byte aligned and stay as it is while the scene is open
+		bool view(const void* data, size_t size);
+		void close(void);
+		bool isOpen(void) const { return m_header != NULL; }
+
+		float width(void) const { return m_header->width; }
+		float depth(void) const { return m_header->depth; }
+		float radius(void) const { return m_header->radius; }
+		float damping(void) const { return m_header->damping; }
+
+		int boxCount(void) const { return (int)m_header->boxCount; }
+		const SceneBox& box(int k) const { return m_boxes[k]; }
+		int polygonCount(void) const { return (int)m_header->polygonCount; }
+		const ScenePoint* polygon(int k, int& count) const
+		{
+			count = (int)m_polygons[k].count;
+			return m_points + m_polygons[k].first;
+		}
+
+		int ballCount(void) const { return (int)m_header->ballCount; }
+		const ScenePoint* centers(void) const { return m_centers; }
+		unsigned int color(int i) const { return m_colors[i]; }
+
+		// give world the cushions and physics of the scene and its balls, at
+		// rest. the solver and fixed step of world stay as they are
+		void apply(World& world) const;
+		// only the cushions
+		void applyCushions(Cushions& cushions) const;
+
+	private:
+		Scene(const Scene&);
+		Scene& operator=(const Scene&);
+
+		const SceneHeader*      m_header;
+		const SceneBox*         m_boxes;
+		const ScenePolygon*     m_polygons;
+		const ScenePoint*       m_points;
+		const ScenePoint*       m_centers;
+		const unsigned int*     m_colors;
+		void*                   m_map;          // mapping of open(), or NULL
+		size_t                  m_mapSize;
+	};
+
+	// scene file image of a text description (see above). false, with the
+	// line and what is wrong with it in error, on a line it cannot read
+	bool compileScene(const char* text, std::vector<unsigned char>& image, std::string& error);
+}
+
+#endif // __sceneH__
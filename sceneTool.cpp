@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: sceneTool.cpp
+//
+// Writes scene files (scene.h) from their text description, and checks
+// scene files.
+//
+//   sceneTool <description.txt> <scene.vlsc>   compile a description
+//   sceneTool --info <scene.vlsc>              load a scene file and list it
+//
+// Built as the sceneTool target of CMakeLists.txt.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "scene.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace sim;
+
+static bool readText(const char* path, std::string& text)
+{
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+		return false;
+	char buf[4096];
+	size_t got;
+	while ((got = fread(buf, 1, sizeof(buf), fp)) > 0)
+		text.append(buf, got);
+	fclose(fp);
+	return true;
+}
+
+static int compile(const char* textPath, const char* scenePath)
+{
+	std::string text, error;
+	if (!readText(textPath, text)) {
+		fprintf(stderr, "cannot open %s\n", textPath);
+		return 1;
+	}
+	std::vector<unsigned char> image;
+	if (!compileScene(text.c_str(), image, error)) {
+		fprintf(stderr, "%s: %s\n", textPath, error.c_str());
+		return 1;
+	}
+
+	FILE* fp = fopen(scenePath, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "cannot write %s\n", scenePath);
+		return 1;
+	}
+	bool ok = fwrite(&image[0], 1, image.size(), fp) == image.size();
+	if (fclose(fp) != 0 || !ok) {
+		fprintf(stderr, "cannot write %s\n", scenePath);
+		return 1;
+	}
+	return 0;
+}
+
+static int info(const char* scenePath)
+{
+	Scene scene;
+	if (!scene.open(scenePath)) {
+		fprintf(stderr, "%s is not a valid scene file\n", scenePath);
+		return 1;
+	}
+	printf("table %g x %g, radius %g, damping %g\n", scene.width(), scene.depth(), scene.radius(), scene.damping());
+	for (int k = 0; k < scene.boxCount(); k++) {
+		const SceneBox& b = scene.box(k);
+		printf("box %g %g %g %g\n", b.x, b.z, b.width, b.depth);
+	}
+	for (int k = 0; k < scene.polygonCount(); k++) {
+		int count;
+		const ScenePoint* pts = scene.polygon(k, count);
+		printf("polygon");
+		for (int p = 0; p < count; p++)
+			printf(" %g %g", pts[p][0], pts[p][1]);
+		printf("\n");
+	}
+	for (int i = 0; i < scene.ballCount(); i++)
+		printf("ball %g %g %08x\n", scene.centers()[i][0], scene.centers()[i][1], scene.color(i));
+
+	World world;
+	scene.apply(world);
+	printf("%d cushion segments\n", world.cushions().segmentCount());
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 3 && strcmp(argv[1], "--info") == 0)
+		return info(argv[2]);
+	if (argc == 3 && argv[1][0] != '-')
+		return compile(argv[1], argv[2]);
+	fprintf(stderr, "usage: %s <description.txt> <scene.vlsc>\n       %s --info <scene.vlsc>\n", argv[0], argv[0]);
+	return 2;
+}
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotBatch.cpp
+//
+// Batch shot simulator. See shotBatch.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "shotBatch.h"
+#include "threadPool.h"
+#include "eventSolver.h"
+#include <algorithm>
+
+namespace sim
+{
+	ShotBatch::ShotBatch(ThreadPool& pool, Game game)
+		: m_pool(pool), m_rules(rulesFor(game)), m_scratch(pool.size())
+	{
+	}
+
+	void ShotBatch::run(const World& table, int cueBall, const Vec2* cueVelocity, int count,
+		Vec2* finalPositions, ShotResult* results)
+	{
+		m_vx.resize(count);
+		m_vz.resize(count);
+		for (int k = 0; k < count; k++) {
+			m_vx[k] = cueVelocity[k].x;
+			m_vz[k] = cueVelocity[k].z;
+		}
+		play(table, cueBall, count, finalPositions, results);
+	}
+
+	void ShotBatch::run(const World& table, int cueBall, const Real* dirX, const Real* dirZ, const Real* power,
+		int count, Vec2* finalPositions, ShotResult* results)
+	{
+		m_vx.resize(count);
+		m_vz.resize(count);
+		if (count > 0)
+			launchVelocities(dirX, dirZ, power, count, &m_vx[0], &m_vz[0]);
+		play(table, cueBall, count, finalPositions, results);
+	}
+
+	// play the shots of m_vx, m_vz
+	void ShotBatch::play(const World& table, int cueBall, int count, Vec2* finalPositions, ShotResult* results)
+	{
+		const int n = table.ballCount();
+
+		// several chunks per worker so stealing can even out long and short shots
+		int grain = std::max(1, count / (m_pool.size() * 8));
+
+		m_pool.parallelFor(count, grain, [&](int begin, int end, int worker) {
+			World& w = m_scratch[worker];
+			for (int k = begin; k < end; k++) {
+				w = table;
+				w.clearContacts();
+				w.setPower(cueBall, m_vx[k], m_vz[k]);
+
+				ShotResult& r = results[k];
+				r.events = EventSolver::runToRest(w);
+				r.scoreDelta = m_rules.judge(w.contacts(), cueBall).points;
+				r.contacts = contactBits(w);
+				for (int i = 0; i < n; i++)
+					finalPositions[k * n + i] = w.getCenter(i);
+			}
+		});
+	}
+}
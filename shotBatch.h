@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotBatch.h
+//
+// Batch shot simulator for shot search (AI opponent, Monte Carlo).
+// Takes a table and many candidate cue velocities and plays every shot to
+// rest, headless, spread over a work-stealing ThreadPool. Each worker keeps
+// its own scratch World, so shots never share mutable state.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __shotBatchH__
+#define __shotBatchH__
+
+#include "billiardSim.h"
+#include "rules.h"
+#include <cstddef>
+
+namespace sim
+{
+	class ThreadPool;
+
+	struct ShotResult {
+		unsigned int    contacts;      // bit contactBit(i, j) set when balls i and j touched
+		int             scoreDelta;    // points the rules give the shot
+		int             events;        // events the solver handled
+	};
+
+	// bit of the pair (i, j) in ShotResult::contacts. covers the first 8 balls
+	inline int contactBit(int i, int j)
+	{
+		if (i > j) { int t = i; i = j; j = t; }
+		return j * (j - 1) / 2 + i;
+	}
+
+	// contacts of the last shot on world as ShotResult::contacts bits
+	inline unsigned int contactBits(const World& world)
+	{
+		const std::vector<ContactEvent>& contacts = world.contacts();
+		unsigned int bits = 0;
+		for (size_t k = 0; k < contacts.size(); k++) {
+			const ContactEvent& e = contacts[k];
+			if (e.type == ContactEvent::BALL && e.b < 8)
+				bits |= 1u << contactBit(e.a, e.b);
+		}
+		return bits;
+	}
+
+	class ShotBatch {
+	public:
+		// shots are judged by the rules of game
+		explicit ShotBatch(ThreadPool& pool, Game game = FOUR_BALL);
+
+		// play one shot per cue velocity from table until every ball rests.
+		// finalPositions gets count * table.ballCount() centers, shot after shot
+		void run(const World& table, int cueBall, const Vec2* cueVelocity, int count,
+			Vec2* finalPositions, ShotResult* results);
+		// the same for count cue strokes given as arrays of direction and
+		// power, launched together (see launchVelocities)
+		void run(const World& table, int cueBall, const Real* dirX, const Real* dirZ, const Real* power,
+			int count, Vec2* finalPositions, ShotResult* results);
+
+	private:
+		void play(const World& table, int cueBall, int count, Vec2* finalPositions, ShotResult* results);
+
+		ThreadPool&         m_pool;
+		const Rules&        m_rules;
+		std::vector<World>  m_scratch;   // one table per worker
+		std::vector<Real>   m_vx, m_vz;  // cue velocity of every shot
+	};
+}
+
+#endif // __shotBatchH__
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotCache.cpp
+//
+// Cache of predicted shots. See shotCache.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "shotCache.h"
+#include "eventSolver.h"
+#include <algorithm>
+#include <cmath>
+
+namespace sim
+{
+	// a shot still rolling after this long is cut off where it is
+	static const float MAX_SHOT_SECONDS = 120;
+
+	// grid steps a key word reaches either way. far past any table, and
+	// small enough that the cast to int is defined
+	static const double MAX_STEPS = 1 << 30;
+
+	// v rounded to the grid, clamped to MAX_STEPS. NaN goes to 0
+	static int quantize(Real v, Real step)
+	{
+		double k = std::floor((double)v / step + 0.5);
+		if (std::isnan(k))
+			return 0;
+		return (int)std::max(-MAX_STEPS, std::min(k, MAX_STEPS));
+	}
+
+	ShotCache::ShotCache(size_t budget, float positionStep, float velocityStep, float sampleInterval)
+		: m_budget(budget), m_positionStep(positionStep), m_velocityStep(velocityStep),
+		m_sampleInterval(sampleInterval), m_rules(&rulesFor(FOUR_BALL)), m_bytes(0), m_hits(0), m_misses(0)
+	{
+	}
+
+	void ShotCache::makeKey(const World& table, int cueBall, Vec2 cueVelocity)
+	{
+		const BallStore& b = table.balls();
+		std::vector<int>& q = m_key.q;
+		q.resize(3 + 4 * b.size());
+		q[0] = cueBall;
+		q[1] = quantize(cueVelocity.x, m_velocityStep);
+		q[2] = quantize(cueVelocity.z, m_velocityStep);
+		for (int i = 0; i < b.size(); i++) {
+			q[3 + 4 * i] = quantize(b.x[i], m_positionStep);
+			q[4 + 4 * i] = quantize(b.z[i], m_positionStep);
+			q[5 + 4 * i] = quantize(b.vx[i], m_velocityStep);
+			q[6 + 4 * i] = quantize(b.vz[i], m_velocityStep);
+		}
+
+		// FNV-1a over the words
+		unsigned long long h = 14695981039346656037ULL;
+		for (size_t k = 0; k < q.size(); k++) {
+			h ^= (unsigned int)q[k];
+			h *= 1099511628211ULL;
+		}
+		m_key.hash = (size_t)h;
+	}
+
+	const ShotPrediction* ShotCache::find(const World& table, int cueBall, Vec2 cueVelocity)
+	{
+		makeKey(table, cueBall, cueVelocity);
+		std::unordered_map<Key, List::iterator, KeyHash>::iterator it = m_index.find(m_key);
+		if (it == m_index.end())
+			return NULL;
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		m_hits++;
+		return &it->second->prediction;
+	}
+
+	const ShotPrediction& ShotCache::predict(const World& table, int cueBall, Vec2 cueVelocity)
+	{
+		if (const ShotPrediction* p = find(table, cueBall, cueVelocity))
+			return *p;
+		m_misses++;
+		m_scratch = table;
+
+		m_lru.push_front(Entry());
+		Entry& e = m_lru.front();
+		e.key = m_key;
+		simulate(e.prediction);
+		// the index holds a second copy of the key
+		e.bytes = sizeof(Entry) + e.prediction.path.size() * sizeof(Vec2)
+			+ sizeof(Key) + 2 * e.key.q.size() * sizeof(int) + 2 * sizeof(void*);
+		m_bytes += e.bytes;
+		m_index[e.key] = m_lru.begin();
+		evict();
+		return e.prediction;
+	}
+
+	// play the shot of m_key from m_scratch, a copy of the queried table
+	void ShotCache::simulate(ShotPrediction& p)
+	{
+		World& w = m_scratch;
+		const std::vector<int>& q = m_key.q;
+		const int n = w.ballCount();
+		for (int i = 0; i < n; i++) {
+			w.setCenter(i, q[3 + 4 * i] * m_positionStep, q[4 + 4 * i] * m_positionStep);
+			w.setPower(i, q[5 + 4 * i] * m_velocityStep, q[6 + 4 * i] * m_velocityStep);
+		}
+		w.setPower(q[0], q[1] * m_velocityStep, q[2] * m_velocityStep);
+		w.clearContacts();
+		w.cushions().build(w.getRadius());
+
+		p.ballCount = n;
+		p.sampleInterval = m_sampleInterval;
+		p.path.clear();
+		for (int i = 0; i < n; i++)
+			p.path.push_back(w.getCenter(i));
+
+		const int maxSamples = (int)(MAX_SHOT_SECONDS / m_sampleInterval);
+		int events = 0;
+		for (int s = 0; s < maxSamples && !w.isStopped(); s++) {
+			events += EventSolver::advance(w, m_sampleInterval);
+			for (int i = 0; i < n; i++)
+				p.path.push_back(w.getCenter(i));
+		}
+
+		p.result.events = events;
+		p.result.scoreDelta = m_rules->judge(w.contacts(), q[0]).points;
+		p.result.contacts = contactBits(w);
+	}
+
+	// the least recently used entries go first, but the newest one stays
+	// even when it alone is over the budget
+	void ShotCache::evict(void)
+	{
+		while (m_bytes > m_budget && m_lru.size() > 1) {
+			Entry& e = m_lru.back();
+			m_bytes -= e.bytes;
+			m_index.erase(e.key);
+			m_lru.pop_back();
+		}
+	}
+
+	void ShotCache::clear(void)
+	{
+		m_index.clear();
+		m_lru.clear();
+		m_bytes = 0;
+	}
+}
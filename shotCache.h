@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotCache.h
+//
+// Cache of predicted shots for aim previews and shot search.
+// A shot is keyed on the table quantized to a grid: every ball center and
+// velocity, and the cue velocity, rounded to a step. Aims that only differ
+// by less than a step share one entry, so re-aiming around the same spot
+// simulates once and then answers from memory. A miss plays the snapped
+// shot, not the exact query, so an entry is a function of its key alone.
+// Entries are evicted least recently used first once their memory passes
+// the budget.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __shotCacheH__
+#define __shotCacheH__
+
+#include "shotBatch.h"
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+
+namespace sim
+{
+	// a shot played to rest, sampled every sampleInterval seconds
+	struct ShotPrediction {
+		ShotResult          result;
+		int                 ballCount;
+		float               sampleInterval;
+		std::vector<Vec2>   path;      // ballCount centers per sample, sample after sample
+
+		// sample 0 is the table as struck, the last one the table at rest
+		int sampleCount(void) const { return ballCount > 0 ? (int)path.size() / ballCount : 0; }
+		Vec2 center(int sample, int i) const { return path[sample * ballCount + i]; }
+		Vec2 finalCenter(int i) const { return center(sampleCount() - 1, i); }
+	};
+
+	class ShotCache {
+	public:
+		// budget: bytes of predictions kept. positionStep and velocityStep:
+		// grid the table and the cue velocity are rounded to (one aim step
+		// of the game moves the cue velocity by 0.007)
+		explicit ShotCache(size_t budget = 8 << 20, float positionStep = 0.001f,
+			float velocityStep = 0.01f, float sampleInterval = 1.0f / 30);
+
+		// the shot of cueBall with cueVelocity from table, played if it is
+		// not cached yet. the cushions, ball model and spin are not part of
+		// the key: a cache only serves one layout and model, clear() it when
+		// they change. values off the grid (NaN, or more than 2^30 steps
+		// out) are clamped onto it.
+		// the reference stays valid until the next predict() or clear()
+		const ShotPrediction& predict(const World& table, int cueBall, Vec2 cueVelocity);
+		// the cached shot, or NULL. never simulates
+		const ShotPrediction* find(const World& table, int cueBall, Vec2 cueVelocity);
+
+		void clear(void);
+		// judge shots by the rules of game (FOUR_BALL unless set) from now
+		// on. clears the cache
+		void setGame(Game game) { m_rules = &rulesFor(game);   clear(); }
+
+		int size(void) const { return (int)m_lru.size(); }
+		size_t bytes(void) const { return m_bytes; }
+		size_t budget(void) const { return m_budget; }
+		long long hits(void) const { return m_hits; }
+		long long misses(void) const { return m_misses; }
+
+	private:
+		struct Key {
+			std::vector<int>    q;          // cue ball, cue velocity, then x, z, vx, vz of every ball
+			size_t              hash;
+
+			bool operator==(const Key& k) const { return hash == k.hash && q == k.q; }
+		};
+		struct KeyHash {
+			size_t operator()(const Key& k) const { return k.hash; }
+		};
+		struct Entry {
+			Key                 key;
+			ShotPrediction      prediction;
+			size_t              bytes;
+		};
+		typedef std::list<Entry> List;
+
+		ShotCache(const ShotCache&);
+		ShotCache& operator=(const ShotCache&);
+
+		void makeKey(const World& table, int cueBall, Vec2 cueVelocity);
+		void simulate(ShotPrediction& p);
+		void evict(void);
+
+		size_t                                      m_budget;
+		float                                       m_positionStep;
+		float                                       m_velocityStep;
+		float                                       m_sampleInterval;
+		const Rules*                                m_rules;
+		List                                        m_lru;      // most recently used first
+		std::unordered_map<Key, List::iterator, KeyHash> m_index;
+		size_t                                      m_bytes;
+		long long                                   m_hits, m_misses;
+		Key                                         m_key;      // of the last query
+		World                                       m_scratch;
+	};
+}
+
+#endif // __shotCacheH__
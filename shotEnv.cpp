@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotEnv.cpp
+//
+// Reinforcement-learning environments. See shotEnv.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "shotEnv.h"
+#include "table.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace sim
+{
+	// -------------------------------------------------------------------------
+	// ShotEnv
+	// -------------------------------------------------------------------------
+
+	// the opening table is the one a Table of the game sets up
+	ShotEnv::ShotEnv(Game game, int episodeShots)
+		: m_rules(&rulesFor(game)), m_episodeShots(episodeShots)
+	{
+		Table table(game);
+		m_start = table.world();
+		reset();
+	}
+
+	bool ShotEnv::load(const Scene& scene)
+	{
+		Table table(m_rules->game());
+		if (!table.load(scene))
+			return false;
+		m_start = table.world();
+		return true;
+	}
+
+	void ShotEnv::reset(void)
+	{
+		m_world = m_start;
+		m_whiteTurn = true;
+		m_wScore = m_yScore = 0;
+		m_shots = 0;
+	}
+
+	int ShotEnv::step(float vx, float vz)
+	{
+		// a policy can ask for anything, infinities and NaN included. a
+		// velocity that is not finite plays as no shot at all
+		if (!Table::limitSpeed(vx, vz))
+			vx = vz = 0;
+
+		int cue = cueBall();
+		m_world.clearContacts();
+		m_world.setPower(cue, vx, vz);
+		m_world.runToRest();
+
+		ShotOutcome outcome = m_rules->judge(m_world.contacts(), cue);
+		if (m_whiteTurn)
+			m_wScore += outcome.points;
+		else
+			m_yScore += outcome.points;
+		if (!outcome.keepTurn)
+			m_whiteTurn = !m_whiteTurn;
+		m_shots++;
+		return outcome.points;
+	}
+
+	void ShotEnv::observe(float* observation) const
+	{
+		int own = cueBall(), other = m_rules->cueBall(m_whiteTurn ? 1 : 0);
+		float* o = observation;
+		*o++ = (float)m_world.getCenter(own).x;     *o++ = (float)m_world.getCenter(own).z;
+		*o++ = (float)m_world.getCenter(other).x;   *o++ = (float)m_world.getCenter(other).z;
+		for (int i = 0; i < m_world.ballCount(); i++) {
+			if (i == own || i == other)
+				continue;
+			*o++ = (float)m_world.getCenter(i).x;
+			*o++ = (float)m_world.getCenter(i).z;
+		}
+	}
+
+	// -------------------------------------------------------------------------
+	// ShotEnvs
+	// -------------------------------------------------------------------------
+
+	ShotEnvs::ShotEnvs(ThreadPool& pool, int count, Game game, int episodeShots)
+		: m_pool(pool), m_envs(std::max(count, 1), ShotEnv(game, episodeShots))
+	{
+		m_observations.resize(m_envs.size() * observationSize());
+		m_rewards.assign(m_envs.size(), 0);
+		m_dones.assign(m_envs.size(), 0);
+		m_whiteTurns.assign(m_envs.size(), 1);
+		reset();
+	}
+
+	bool ShotEnvs::load(const Scene& scene)
+	{
+		ShotEnv loaded = m_envs[0];
+		if (!loaded.load(scene))
+			return false;
+		loaded.reset();
+		std::fill(m_envs.begin(), m_envs.end(), loaded);
+		reset();
+		return true;
+	}
+
+	void ShotEnvs::observe(int k)
+	{
+		const ShotEnv& env = m_envs[k];
+		env.observe(&m_observations[k * observationSize()]);
+		m_whiteTurns[k] = env.whiteTurn() ? 1 : 0;
+	}
+
+	void ShotEnvs::reset(void)
+	{
+		for (int k = 0; k < count(); k++) {
+			m_envs[k].reset();
+			observe(k);
+			m_rewards[k] = 0;
+			m_dones[k] = 0;
+		}
+	}
+
+	void ShotEnvs::step(const float* actions)
+	{
+		// several chunks per worker so stealing can even out long and short shots
+		int grain = std::max(1, count() / (m_pool.size() * 8));
+
+		m_pool.parallelFor(count(), grain, [&](int begin, int end, int) {
+			for (int k = begin; k < end; k++) {
+				ShotEnv& env = m_envs[k];
+				m_rewards[k] = (float)env.step(actions[2 * k], actions[2 * k + 1]);
+				m_dones[k] = env.done() ? 1 : 0;
+				if (env.done())
+					env.reset();
+				observe(k);
+			}
+		});
+	}
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotEnv.h
+//
+// Reinforcement-learning environments over the table, gym style: reset()
+// racks the balls, step() plays one shot and the table is then observed.
+// Nothing is drawn or stepped frame by frame; a shot is played to rest by
+// the event solver in one call.
+// ShotEnvs steps many independent tables at once on a ThreadPool. It keeps
+// the observations, rewards and flags of every table in flat arrays it
+// fills in place, so a trainer reads them where they are (wrapped as numpy
+// arrays, say) without a copy.
+//
+// Observation of a table: (x, z) of every ball as seen by the player to
+// shoot: their own ball first, then the other player's, then the others
+// in index order, so one policy plays both sides.
+// Action: the cue ball velocity (vx, vz), as Table::shoot takes it.
+// Reward: the points the rules (rules.h) give the shot, which is what the
+// shooter's score changes by.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __shotEnvH__
+#define __shotEnvH__
+
+#include "billiardSim.h"
+#include "rules.h"
+
+namespace sim
+{
+	class Scene;
+	class ThreadPool;
+
+	class ShotEnv {
+	public:
+		// game on the standard table. an episode lasts episodeShots shots
+		explicit ShotEnv(Game game = FOUR_BALL, int episodeShots = 50);
+
+		// play on the layout of scene from the next reset() on. false when
+		// the scene does not hold the balls of the game (see Table::load)
+		bool load(const Scene& scene);
+
+		// balls in the opening position, scores cleared, white to play
+		void reset(void);
+		// play one shot of the player to shoot, with the cue velocity cut
+		// to Table::MAX_SPEED, until every ball rests. returns the points it
+		// scored for that player; the turn then passes as the rules say
+		int step(float vx, float vz);
+		bool done(void) const { return m_shots >= m_episodeShots; }
+
+		int observationSize(void) const { return 2 * m_rules->ballCount(); }
+		// write the observation of the table, observationSize() floats
+		void observe(float* observation) const;
+
+		const World& world(void) const { return m_world; }
+		const Rules& rules(void) const { return *m_rules; }
+		int cueBall(void) const { return m_rules->cueBall(m_whiteTurn ? 0 : 1); }
+		bool whiteTurn(void) const { return m_whiteTurn; }
+		int whiteScore(void) const { return m_wScore; }
+		int yellowScore(void) const { return m_yScore; }
+		int shots(void) const { return m_shots; }
+
+	private:
+		const Rules*        m_rules;
+		World               m_start;        // the opening table
+		World               m_world;
+		bool                m_whiteTurn;
+		int                 m_wScore;
+		int                 m_yScore;
+		int                 m_shots;        // since reset()
+		int                 m_episodeShots;
+	};
+
+	class ShotEnvs {
+	public:
+		ShotEnvs(ThreadPool& pool, int count, Game game = FOUR_BALL, int episodeShots = 50);
+
+		int count(void) const { return (int)m_envs.size(); }
+		int observationSize(void) const { return m_envs[0].observationSize(); }
+		ShotEnv& env(int k) { return m_envs[k]; }
+		const ShotEnv& env(int k) const { return m_envs[k]; }
+
+		// play on the layout of scene and reset every table. false, leaving
+		// the tables as they are, when the scene does not fit the game
+		bool load(const Scene& scene);
+
+		// reset every table and observe it
+		void reset(void);
+		// one shot on every table: actions holds count() (vx, vz) pairs. a
+		// table whose episode ended is reset at once, so its observation is
+		// the first of the next episode and its done flag is set
+		void step(const float* actions);
+
+		// count() * observationSize() floats, table after table
+		const float* observations(void) const { return &m_observations[0]; }
+		// per table: the reward of the last step, whether it ended the
+		// episode, and whether white is to play the observation
+		const float* rewards(void) const { return &m_rewards[0]; }
+		const unsigned char* dones(void) const { return &m_dones[0]; }
+		const unsigned char* whiteTurns(void) const { return &m_whiteTurns[0]; }
+
+	private:
+		void observe(int k);
+
+		ThreadPool&                 m_pool;
+		std::vector<ShotEnv>        m_envs;
+		std::vector<float>          m_observations;
+		std::vector<float>          m_rewards;
+		std::vector<unsigned char>  m_dones;
+		std::vector<unsigned char>  m_whiteTurns;
+	};
+}
+
+#endif // __shotEnvH__
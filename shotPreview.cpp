@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotPreview.cpp
+//
+// Ghost path of a shot. See shotPreview.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "shotPreview.h"
+#include <cmath>
+
+namespace sim
+{
+	static void startPath(ShotPreview::Path& path, int ball, Vec2 p)
+	{
+		path.ball = ball;
+		path.count = 1;
+		path.points[0] = p;
+	}
+
+	// the ball of self moves from p with velocity v. follow it off the
+	// cushions until it stops, touches a ball other than ignore or the path
+	// is full, adding a point at every turn. returns the ball touched, or
+	// -1; p and v are then where and how fast self touched it
+	static int trace(const World& world, int self, int ignore, Vec2& p, Vec2& v, ShotPreview::Path& path)
+	{
+		const Cushions& cushions = world.cushions();
+		const Real reach2 = 4 * world.getRadius() * world.getRadius();
+		const Real damping = world.getDamping();
+
+		while (path.count < ShotPreview::MAX_POINTS) {
+			Real speed = std::sqrt(dot(v, v));
+			if (speed <= STOP_SPEED)
+				return -1;
+			Vec2 u = v / speed;
+			// distance left before the ball is at rest
+			double best = (speed - STOP_SPEED) * TIME_SCALE / damping;
+
+			// the nearest ball the path sweeps into
+			int hit = -1;
+			for (int k = 0; k < world.ballCount(); k++) {
+				if (k == self || k == ignore)
+					continue;
+				Vec2 d = p - world.getCenter(k);
+				Real b = dot(d, u);
+				if (b >= 0)
+					continue;       // moving away from it
+				Real c = dot(d, d) - reach2;
+				Real disc = b * b - c;
+				if (disc < 0)
+					continue;
+				double s = c <= 0 ? 0 : -b - std::sqrt(disc);
+				if (s < best) {
+					best = s;
+					hit = k;
+				}
+			}
+
+			int segment;
+			double s = cushions.timeOfImpact(p.x, p.z, u.x, u.z, best, segment);
+			if (s >= 0) {
+				hit = -1;
+				best = s;
+			}
+
+			p += u * (Real)best;
+			v = u * (speed - (Real)best * damping / TIME_SCALE);
+			path.points[path.count++] = p;
+			if (hit >= 0)
+				return hit;
+			if (segment < 0)
+				return -1;          // came to rest
+			cushions.bounce(p.x, p.z, v.x, v.z, segment);
+		}
+		return -1;
+	}
+
+	void previewShot(const World& world, int cueBall, Vec2 cueVelocity, ShotPreview& preview)
+	{
+		preview.object.ball = -1;
+		preview.object.count = 0;
+
+		Vec2 p = world.getCenter(cueBall), v = cueVelocity;
+		startPath(preview.cue, cueBall, p);
+		int first = trace(world, cueBall, -1, p, v, preview.cue);
+		if (first < 0)
+			return;
+
+		// the balls trade the velocity along the line of centers (World::hitBy)
+		Vec2 n = world.getCenter(first) - p;
+		Real len = std::sqrt(dot(n, n));
+		if (len == 0)
+			return;
+		n = n / len;
+		Vec2 vn = n * dot(v, n);
+		v -= vn;
+
+		Vec2 q = world.getCenter(first);
+		startPath(preview.object, first, q);
+		trace(world, first, cueBall, q, vn, preview.object);
+		trace(world, cueBall, first, p, v, preview.cue);
+	}
+}
@@ -0,0 +1,42 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotPreview.h
+//
+// Ghost path of a shot for aiming: where the cue ball goes, and where the
+// first ball it strikes goes, up to a few collisions. Nothing is stepped.
+// A ball's speed falls linearly with the distance it covers (see
+// eventSolver.h), so each leg of a path is one cast against the cushion
+// grid and the resting balls, and a preview costs microseconds however far
+// the balls roll.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __shotPreviewH__
+#define __shotPreviewH__
+
+#include "billiardSim.h"
+
+namespace sim
+{
+	struct ShotPreview {
+		enum { MAX_POINTS = 8 };
+
+		// a polyline of ball centers from where the ball starts to where it
+		// stops, or to where it touches another ball
+		struct Path {
+			int             ball;       // -1 when there is no path
+			int             count;
+			Vec2            points[MAX_POINTS];
+		};
+
+		Path            cue;        // ends at the second ball the cue ball touches
+		Path            object;     // the first ball the cue ball touches, to its first contact
+	};
+
+	// preview of striking cueBall with cueVelocity on world, whose balls are
+	// at rest. the balls the two paths do not start from stay where they are.
+	// follows the damped model (World::DAMPED) whatever the model of world
+	void previewShot(const World& world, int cueBall, Vec2 cueVelocity, ShotPreview& preview);
+}
+
+#endif // __shotPreviewH__
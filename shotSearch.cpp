@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotSearch.cpp
+//
+// Coarse-to-fine shot search. See shotSearch.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "shotSearch.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace sim
+{
+	static const Real TWO_PI = (Real)6.28318530717958647692;
+
+	ShotSearch::ShotSearch(ThreadPool& pool, Game game, const SearchParams& params)
+		: m_batch(pool, game), m_rules(rulesFor(game)), m_params(params)
+	{
+	}
+
+	// play the shots of m_angle, m_power and add them to the candidates
+	void ShotSearch::play(const World& table, int cueBall)
+	{
+		const int count = (int)m_angle.size();
+		m_dirX.resize(count);
+		m_dirZ.resize(count);
+		for (int k = 0; k < count; k++) {
+			m_dirX[k] = std::cos(m_angle[k]);
+			m_dirZ[k] = std::sin(m_angle[k]);
+		}
+		m_final.resize(count * table.ballCount());
+		m_results.resize(count);
+		m_batch.run(table, cueBall, &m_dirX[0], &m_dirZ[0], &m_power[0], count, &m_final[0], &m_results[0]);
+
+		for (int k = 0; k < count; k++) {
+			Candidate c;
+			c.angle = m_angle[k];
+			c.power = m_power[k];
+			c.points = m_results[k].scoreDelta;
+			c.value = 1000 * (Real)c.points + closeness(table, cueBall, k);
+			m_candidates.push_back(c);
+		}
+		m_result.shots += count;
+	}
+
+	// 10 for every object ball the cue ball touched, less the distance from
+	// where it stopped to the nearest one it missed. the rules say which
+	// balls are object balls (Rules::isObjectBall)
+	Real ShotSearch::closeness(const World& table, int cueBall, int shot) const
+	{
+		const int n = table.ballCount();
+		const Vec2* rest = &m_final[shot * n];
+		Real value = 0, gap = -1;
+		for (int i = 0; i < n && i < 8; i++) {
+			if (!m_rules.isObjectBall(i, cueBall))
+				continue;
+			if (m_results[shot].contacts & (1u << contactBit(i, cueBall))) {
+				value += 10;
+				continue;
+			}
+			Vec2 d = rest[i] - rest[cueBall];
+			Real dist = std::sqrt(dot(d, d));
+			if (gap < 0 || dist < gap)
+				gap = dist;
+		}
+		return gap < 0 ? value : value - gap;
+	}
+
+	// the best candidates, no two closer in angle than spacing at the
+	// same power
+	void ShotSearch::pickSeeds(Real spacing)
+	{
+		std::stable_sort(m_candidates.begin(), m_candidates.end());
+		m_seeds.clear();
+		for (size_t k = 0; k < m_candidates.size() && (int)m_seeds.size() < m_params.seeds; k++) {
+			const Candidate& c = m_candidates[k];
+			bool near = false;
+			for (size_t s = 0; s < m_seeds.size() && !near; s++) {
+				Real da = std::fabs(std::remainder(c.angle - m_seeds[s].angle, TWO_PI));
+				near = da < spacing && std::fabs(c.power - m_seeds[s].power) < (Real)1e-3 * c.power;
+			}
+			if (!near)
+				m_seeds.push_back(c);
+		}
+	}
+
+	const SearchResult& ShotSearch::find(const World& table, int cueBall)
+	{
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point start = Clock::now();
+		m_result.shots = 0;
+		m_result.rounds = 0;
+		m_candidates.clear();
+
+		// the first round: a ring of directions at each power
+		Real spacing = TWO_PI / (Real)m_params.angles;
+		m_angle.clear();
+		m_power.clear();
+		for (int p = 0; p < m_params.powers; p++) {
+			float t = m_params.powers > 1 ? (float)p / (float)(m_params.powers - 1) : 0;
+			for (int a = 0; a < m_params.angles; a++) {
+				m_angle.push_back(spacing * (Real)a);
+				m_power.push_back(m_params.minPower + (m_params.maxPower - m_params.minPower) * t);
+			}
+		}
+
+		// later rounds: 7 directions a quarter of the spacing apart and
+		// three powers around every seed, the seed itself left out
+		Real powerStep = (Real)0.15;
+		for (;;) {
+			play(table, cueBall);
+			m_result.rounds++;
+			pickSeeds(spacing);
+			double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			if (m_candidates[0].points > 0 || m_result.rounds > m_params.rounds || seconds >= m_params.budget)
+				break;
+
+			spacing /= 4;
+			m_angle.clear();
+			m_power.clear();
+			for (size_t s = 0; s < m_seeds.size(); s++) {
+				for (int a = -3; a <= 3; a++) {
+					for (int p = -1; p <= 1; p++) {
+						if (a == 0 && p == 0)
+							continue;
+						m_angle.push_back(m_seeds[s].angle + spacing * (Real)a);
+						m_power.push_back(m_seeds[s].power * (1 + powerStep * (Real)p));
+					}
+				}
+			}
+			powerStep /= 2;
+		}
+
+		const Candidate& best = m_candidates[0];
+		// launched as the batch launched it, so it plays out the same
+		m_result.velocity = launchVelocity(CueStroke(Vec2(std::cos(best.angle), std::sin(best.angle)), best.power, 0, 0));
+		m_result.points = best.points;
+		m_result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		return m_result;
+	}
+}
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotSearch.h
+//
+// Shot search for the computer player: finds a shot that scores from the
+// table as it is, under the rules of the game (for four-ball, the cue ball
+// touches both reds and not the other player's ball).
+// The search goes coarse to fine. A first round plays a ring of directions
+// at a few powers. Each later round plays a tighter pattern around the best
+// shots so far, a quarter of the spacing of the round before. Every round
+// is one ShotBatch spread over the ThreadPool, and the search stops after
+// the first round that finds a scoring shot, or when its time is up.
+// Shots that do not score are ranked by how close they come: the object
+// balls the cue ball touched, then how near it ends to one it missed.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __shotSearchH__
+#define __shotSearchH__
+
+#include "shotBatch.h"
+
+namespace sim
+{
+	struct SearchParams {
+		int             angles;         // directions of the first round, evenly around the cue ball
+		int             powers;         // cue speeds of the first round, minPower to maxPower
+		float           minPower, maxPower;
+		int             seeds;          // best shots a finer round is played around
+		int             rounds;         // finer rounds at most
+		double          budget;         // seconds. no round starts after this
+
+		SearchParams(void) : angles(96), powers(4), minPower(2.5f), maxPower(8.5f), seeds(12), rounds(4), budget(0.05) {}
+	};
+
+	struct SearchResult {
+		Vec2            velocity;       // cue velocity of the best shot found
+		int             points;         // the points the rules give it
+		int             shots;          // shots played
+		int             rounds;         // rounds played, the first one included
+		double          seconds;
+	};
+
+	class ShotSearch {
+	public:
+		explicit ShotSearch(ThreadPool& pool, Game game = FOUR_BALL, const SearchParams& params = SearchParams());
+
+		// the best shot for cueBall from table. the reference stays valid
+		// until the next find()
+		const SearchResult& find(const World& table, int cueBall);
+
+	private:
+		struct Candidate {
+			Real            angle, power;
+			Real            value;          // rank: points, then how close it came
+			int             points;
+
+			bool operator<(const Candidate& c) const { return value > c.value; }
+		};
+
+		void play(const World& table, int cueBall);
+		Real closeness(const World& table, int cueBall, int shot) const;
+		void pickSeeds(Real spacing);
+
+		ShotBatch                   m_batch;
+		const Rules&                m_rules;
+		SearchParams                m_params;
+		std::vector<Real>           m_angle, m_power;       // shots of the round
+		std::vector<Real>           m_dirX, m_dirZ;
+		std::vector<Vec2>           m_final;
+		std::vector<ShotResult>     m_results;
+		std::vector<Candidate>      m_candidates;           // every shot played, best first after a round
+		std::vector<Candidate>      m_seeds;
+		SearchResult                m_result;
+	};
+}
+
+#endif // __shotSearchH__
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: simThread.cpp
+//
+// Fixed-rate simulation thread. See simThread.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "simThread.h"
+
+namespace sim
+{
+	// after a stall longer than this many ticks, drop the backlog instead of
+	// running the table faster than real time to catch up
+	static const int MAX_LAG_TICKS = 8;
+
+	SimThread::SimThread(double rate)
+		: m_search(m_pool, m_table.rules().game()), m_rate(rate), m_epoch(Clock::now()), m_quit(false)
+	{
+		m_table.setSearch(&m_search);
+		// the UI sees the opening position before the first tick
+		publish(0, 0);
+		update();
+		m_previous = m_latest;
+	}
+
+	SimThread::~SimThread(void)
+	{
+		stop();
+	}
+
+	void SimThread::start(void)
+	{
+		if (m_thread.joinable())
+			return;
+		m_quit = false;
+		m_thread = std::thread(&SimThread::run, this);
+	}
+
+	void SimThread::stop(void)
+	{
+		if (!m_thread.joinable())
+			return;
+		m_quit = true;
+		m_thread.join();
+	}
+
+	double SimThread::now(void) const
+	{
+		return std::chrono::duration<double>(Clock::now() - m_epoch).count();
+	}
+
+	bool SimThread::update(void)
+	{
+		if (!m_snapshots.update())
+			return false;
+		m_previous = m_latest;
+		m_latest = m_snapshots.front();
+		return true;
+	}
+
+	void SimThread::publish(unsigned int tick, double time)
+	{
+		TableSnapshot& s = m_snapshots.back();
+		const World& world = m_table.world();
+		s.ballCount = world.ballCount();
+		for (int i = 0; i < s.ballCount; i++) {
+			s.x[i] = (float)world.getCenter(i).x;
+			s.z[i] = (float)world.getCenter(i).z;
+		}
+		s.aimX = (float)m_table.getAim().x;
+		s.aimZ = (float)m_table.getAim().z;
+		s.preview = m_table.preview();
+		const ShotPrediction* prediction = m_table.aimPrediction();
+		s.aimPredicted = prediction != NULL;
+		s.aimPoints = prediction != NULL ? prediction->result.scoreDelta : 0;
+		s.stopped = m_table.isStopped();
+		s.whiteTurn = m_table.whiteTurn();
+		s.cueBall = m_table.cueBall();
+		s.whiteScore = m_table.whiteScore();
+		s.yellowScore = m_table.yellowScore();
+		s.tick = tick;
+		s.time = time;
+		m_profiler.formatOverlay(s.profile, sizeof(s.profile));
+		m_snapshots.publish();
+	}
+
+	void SimThread::run(void)
+	{
+		const float dt = (float)(1 / m_rate);
+		const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / m_rate));
+		Clock::time_point next = Clock::now();
+		unsigned int tick = 0;
+		m_profiler.bind();
+
+		while (!m_quit) {
+			m_profiler.beginFrame();
+			TableInput input;
+			while (m_inputs.pop(input))
+				m_table.apply(input);
+			m_table.step(dt);
+			tick++;
+			// the aim preview is worked out while publishing, so it counts
+			// toward the tick
+			publish(tick, std::chrono::duration<double>(next - m_epoch).count());
+			m_profiler.endFrame();
+
+			next += period;
+			Clock::time_point t = Clock::now();
+			if (t - next > MAX_LAG_TICKS * period)
+				next = t;
+			std::this_thread::sleep_until(next);
+		}
+		m_profiler.unbind();
+	}
+}
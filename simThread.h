@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: simThread.h
+//
+// Runs a Table on its own thread at a fixed rate, apart from rendering.
+// The UI thread posts inputs through an SpscQueue and reads the table
+// through TableSnapshots the simulation publishes into a TripleBuffer
+// after every tick, so a slow Present never stalls the physics and a heavy
+// physics tick never holds up a frame. Snapshots carry their tick time, so
+// the renderer can interpolate between the last two.
+// The thread binds a Profiler of its own, a frame of it being a tick, so
+// the physics scopes show in the overlay (TableSnapshot::profile) and in
+// a trace written together with the UI thread's.
+// The computer player (TableInput::COMPUTER) searches on a pool of its own,
+// so a decision holds up the ticks for the few milliseconds it takes.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __simThreadH__
+#define __simThreadH__
+
+#include "table.h"
+#include "handoff.h"
+#include "profiler.h"
+#include "shotSearch.h"
+#include "threadPool.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+namespace sim
+{
+	// what the renderer needs of a Table after one tick
+	struct TableSnapshot {
+		int             ballCount;
+		float           x[Table::MAX_BALLS], z[Table::MAX_BALLS];
+		float           aimX, aimZ;
+		ShotPreview     preview;
+		bool            aimPredicted;   // stopped, and aimPoints holds
+		int             aimPoints;      // what the aimed shot scores (Table::aimPrediction)
+		bool            stopped;
+		bool            whiteTurn;
+		int             cueBall;    // ball of the player to shoot
+		int             whiteScore, yellowScore;
+		unsigned int    tick;
+		double          time;       // SimThread::now() when the tick was due
+		char            profile[1024];  // overlay of the simulation profiler
+	};
+
+	class SimThread {
+	public:
+		// rate: ticks per second. every tick advances the table by 1 / rate
+		explicit SimThread(double rate = 120);
+		~SimThread(void);
+
+		void start(void);
+		void stop(void);
+
+		// UI thread only. false when the queue is full and input was dropped
+		bool post(const TableInput& input) { return m_inputs.push(input); }
+
+		// UI thread only. takes the latest snapshot if one was published since
+		// the last call; latest() is the newest taken, previous() the one before
+		bool update(void);
+		const TableSnapshot& latest(void) const { return m_latest; }
+		const TableSnapshot& previous(void) const { return m_previous; }
+
+		// seconds since the thread was created, and the tick length
+		double now(void) const;
+		double period(void) const { return 1 / m_rate; }
+
+		// the table itself. only while the thread is stopped
+		const Table& table(void) const { return m_table; }
+		// profiler of the thread. tracing is set before start(), the
+		// profiler is read only while the thread is stopped
+		void setTracing(bool on) { m_profiler.setTracing(on); }
+		const Profiler& profiler(void) const { return m_profiler; }
+		// the rules of the table never change, so any thread
+		const Rules& rules(void) const { return m_table.rules(); }
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		SimThread(const SimThread&);
+		SimThread& operator=(const SimThread&);
+
+		void run(void);
+		void publish(unsigned int tick, double time);
+
+		Table                               m_table;
+		ThreadPool                          m_pool;         // for m_search
+		ShotSearch                          m_search;
+		Profiler                            m_profiler;     // bound to the thread
+		double                              m_rate;
+		Clock::time_point                   m_epoch;
+		std::thread                         m_thread;
+		std::atomic<bool>                   m_quit;
+		SpscQueue<TableInput, 256>          m_inputs;
+		TripleBuffer<TableSnapshot>         m_snapshots;
+		TableSnapshot                       m_latest, m_previous;   // UI thread
+	};
+}
+
+#endif // __simThreadH__
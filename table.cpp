@@ -0,0 +1,217 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: table.cpp
+//
+// One game of billiards. See table.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "table.h"
+#include "scene.h"
+#include "shotSearch.h"
+#include <cmath>
+#include <cstring>
+
+namespace sim
+{
+	const float Table::RAILS[RAIL_COUNT][4] = {
+		{ 0.0f, 3.06f, 9, 0.12f }, { 0.0f, -3.06f, 9, 0.12f },
+		{ 4.56f, 0.0f, 0.12f, 6.24f }, { -4.56f, 0.0f, 0.12f, 6.24f },
+	};
+	// the hardest shot at the aim across the standard table
+	const float Table::MAX_SPEED = 11;
+
+	Table::Table(Game game)
+		: m_rules(&rulesFor(game)), m_search(NULL), m_prediction(NULL), m_recordShots(false), m_recording(false), m_trackStep(0)
+	{
+		m_shotCache.setGame(game);
+		for (int i = 0; i < RAIL_COUNT; i++)
+			m_world.cushions().addBox(RAILS[i][0], RAILS[i][1], RAILS[i][2], RAILS[i][3]);
+		m_world.cushions().build(m_world.getRadius());
+
+		// balls move event by event, so a long frame cannot let them pass
+		// through each other. the physics runs in fixed steps, so a game
+		// plays back the same from its replay
+		m_world.setSolver(World::EVENT_DRIVEN);
+		m_world.setFixedStep(1.0f / 120);
+		memcpy(m_rack, m_rules->rack(), ballCount() * sizeof(m_rack[0]));
+		newGame();
+	}
+
+	bool Table::load(const Scene& scene)
+	{
+		if (scene.ballCount() != ballCount())
+			return false;
+		memcpy(m_rack, scene.centers(), ballCount() * sizeof(m_rack[0]));
+		scene.apply(m_world);
+		// predictions of the old layout no longer hold
+		m_prediction = NULL;
+		m_shotCache.clear();
+		newGame();
+		return true;
+	}
+
+	// balls in the opening position, white to play, and a new replay
+	void Table::newGame(void)
+	{
+		m_world.reset(m_rack, ballCount());
+		m_stopped = true;
+		m_shotPending = false;
+		m_recording = false;
+		m_whiteTurn = true;
+		m_wScore = m_yScore = 0;
+		m_aimX = m_aimZ = 0;
+		m_previewValid = false;
+		m_replay.begin(m_world, true, m_rules->game());
+	}
+
+	bool Table::limitSpeed(float& vx, float& vz)
+	{
+		if (!std::isfinite(vx) || !std::isfinite(vz))
+			return false;
+		double speed2 = (double)vx * vx + (double)vz * vz;
+		if (speed2 > (double)MAX_SPEED * MAX_SPEED) {
+			float k = (float)(MAX_SPEED / std::sqrt(speed2));
+			vx *= k;
+			vz *= k;
+		}
+		return true;
+	}
+
+	bool Table::shoot(float vx, float vz)
+	{
+		// a ball sent off at NaN never comes to rest, and the shot never ends
+		if (!m_stopped || !limitSpeed(vx, vz))
+			return false;
+		m_world.clearContacts();
+		m_world.setPower(cueBall(), vx, vz);
+		m_replay.addCue(m_world, cueBall(), vx, vz);
+		m_stopped = false;
+		m_shotPending = true;
+		m_previewValid = false;
+
+		// samples line up with the fixed steps, so the recording needs one
+		m_recording = m_recordShots && m_world.getFixedStep() > 0;
+		if (m_recording) {
+			m_track.begin(m_world, m_rules->game(), m_world.getFixedStep());
+			m_trackStep = m_world.stepIndex();
+		}
+		return true;
+	}
+
+	// the power is the distance to the aim, so the stroke is the vector from
+	// the cue ball to the aim as it is, up to MAX_SPEED
+	Vec2 Table::aimVelocity(void) const
+	{
+		Vec2 cue = m_world.getCenter(cueBall());
+		float vx = (float)(m_aimX - cue.x), vz = (float)(m_aimZ - cue.z);
+		limitSpeed(vx, vz);
+		return Vec2(vx, vz);
+	}
+
+	bool Table::shootAtAim(void)
+	{
+		Vec2 v = aimVelocity();
+		return shoot((float)v.x, (float)v.z);
+	}
+
+	bool Table::shootBest(void)
+	{
+		if (!m_stopped || m_search == NULL)
+			return false;
+		Vec2 v = m_search->find(m_world, cueBall()).velocity;
+		return shoot((float)v.x, (float)v.z);
+	}
+
+	const ShotPreview& Table::preview(void)
+	{
+		if (m_previewValid)
+			return m_preview;
+		m_previewValid = true;
+		if (m_stopped) {
+			previewShot(m_world, cueBall(), aimVelocity(), m_preview);
+			m_prediction = &m_shotCache.predict(m_world, cueBall(), aimVelocity());
+		} else {
+			m_preview.cue.ball = m_preview.object.ball = -1;
+			m_preview.cue.count = m_preview.object.count = 0;
+			m_prediction = NULL;
+		}
+		return m_preview;
+	}
+
+	void Table::apply(const TableInput& input)
+	{
+		switch (input.type) {
+		case TableInput::CUE:
+			shoot(input.x, input.z);
+			break;
+		case TableInput::RESTART:
+			restart();
+			break;
+		case TableInput::AIM:
+			moveAim(input.x, input.z);
+			break;
+		case TableInput::SHOOT:
+			shootAtAim();
+			break;
+		case TableInput::COMPUTER:
+			shootBest();
+			break;
+		}
+	}
+
+	void Table::restart(void)
+	{
+		m_shotPending = false;
+		m_recording = false;
+		m_stopped = true;
+		m_whiteTurn = true;
+		m_wScore = m_yScore = 0;
+
+		m_world.reset(m_rack, ballCount());
+		m_replay.addReset(m_world);
+		m_previewValid = false;
+	}
+
+	// the balls stay where they are; the other player's ball is the cue ball
+	void Table::passTurn(void)
+	{
+		m_replay.addTurn(m_world);
+		m_whiteTurn = !m_whiteTurn;
+		m_previewValid = false;
+	}
+
+	bool Table::step(float dt)
+	{
+		if (m_world.awakeCount() > 0)
+			m_previewValid = false;
+		m_world.step(dt);
+		if (m_recording) {
+			m_track.add(m_world, (int)(m_world.stepIndex() - m_trackStep));
+			m_trackStep = m_world.stepIndex();
+		}
+		m_stopped = m_world.isStopped();
+		if (!m_stopped || !m_shotPending) {
+			if (m_stopped)
+				m_world.clearContacts();
+			return false;
+		}
+
+		ShotOutcome outcome = m_rules->judge(m_world.contacts(), cueBall());
+		if (m_whiteTurn)
+			m_wScore += outcome.points;
+		else
+			m_yScore += outcome.points;
+		m_replay.addShotEnd(m_world, m_whiteTurn, m_wScore, m_yScore);
+		m_world.clearContacts();
+		m_shotPending = false;
+		if (m_recording) {
+			m_shotTrajectory = m_track.finish();
+			m_recording = false;
+		}
+
+		if (!outcome.keepTurn)
+			passTurn();
+		return true;
+	}
+}
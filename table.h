@@ -0,0 +1,153 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: table.h
+//
+// One game of billiards: the table, the rules it is played by (rules.h),
+// whose turn it is, the scores and the replay being recorded. What used to be globals of virtualLego.cpp
+// (whiteTurn, w_score, y_score, isStop, isBtnPressed), so a process can host
+// any number of games. The game draws one Table; the table server
+// (tableServer.h) steps thousands of them.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __tableH__
+#define __tableH__
+
+#include "billiardSim.h"
+#include "replay.h"
+#include "rules.h"
+#include "shotCache.h"
+#include "shotPreview.h"
+#include "trajectory.h"
+#include <vector>
+
+namespace sim
+{
+	class Scene;
+	class ShotSearch;
+
+	// a player's input to a Table, queued by whoever hosts it
+	struct TableInput {
+		enum Type {
+			CUE,        // strike the cue ball with velocity (x, z)
+			RESTART,    // back to the opening position
+			AIM,        // move the aim target by (x, z)
+			SHOOT,      // strike the cue ball toward the aim target
+			COMPUTER    // the computer plays the shot (Table::shootBest)
+		};
+
+		Type            type;
+		float           x, z;
+	};
+
+	class Table {
+	public:
+		// the most balls any game has
+		enum { MAX_BALLS = 4, RAIL_COUNT = 4 };
+
+		// (x, z, width, depth) of each rail of the standard table
+		static const float RAILS[RAIL_COUNT][4];
+		// cue speed a stroke is cut down to, at the table and in ShotEnv
+		static const float MAX_SPEED;
+		// cut (vx, vz) down to MAX_SPEED. the speed is worked out in double,
+		// so no finite velocity overflows it. false, leaving (vx, vz) as
+		// they are, when either is not finite
+		static bool limitSpeed(float& vx, float& vz);
+
+		// game on the standard table in its opening position (Rules::rack),
+		// white to play. the replay starts recording at once
+		explicit Table(Game game = FOUR_BALL);
+
+		// play on the cushions and physics of scene from now on, opening
+		// with its balls in the order of Rules::rack, and start a new game.
+		// false, leaving the table as it is, when the scene does not hold
+		// the balls of the game
+		bool load(const Scene& scene);
+
+		// strike the cue ball with (vx, vz), cut down to MAX_SPEED. ignored
+		// while balls still move or when the velocity is not finite; returns
+		// whether the shot was played
+		bool shoot(float vx, float vz);
+		bool shoot(const CueStroke& stroke) { Vec2 v = launchVelocity(stroke);   return shoot((float)v.x, (float)v.z); }
+		// balls back to the opening position, scores cleared, white to play
+		void restart(void);
+
+		// point the cue ball is aimed at. shootAtAim() strikes the cue ball
+		// toward it, harder the farther away it is
+		void moveAim(float dx, float dz) { m_aimX += dx;   m_aimZ += dz;   m_previewValid = false; }
+		Vec2 getAim(void) const { return Vec2(m_aimX, m_aimZ); }
+		bool shootAtAim(void);
+
+		// the computer player: search searches the shots of the player to
+		// shoot, and shootBest() plays the best one it finds. search must
+		// play the game of the table and outlive it. none unless set, and
+		// then shootBest() is ignored
+		void setSearch(ShotSearch* search) { m_search = search; }
+		bool shootBest(void);
+
+		// ghost path of shootAtAim() from the table as it is. worked out
+		// again only after the aim or the balls moved; empty while balls move
+		const ShotPreview& preview(void);
+		// shootAtAim() played to rest from the table as it is: where every
+		// ball ends up and what the shot scores. worked out with preview(),
+		// through a ShotCache, so aiming back and forth over the same spots
+		// plays each of them once. NULL while balls move
+		const ShotPrediction* aimPrediction(void) { preview();   return m_prediction; }
+
+		void apply(const TableInput& input);
+
+		// advance dt seconds. when the balls come to rest after a shot, the
+		// rules judge it and the turn passes unless they keep it. returns
+		// whether a shot ended
+		bool step(float dt);
+
+		// record the ball paths of every shot from the next one on, a sample
+		// per fixed step (trajectory.h). off until set
+		void recordShots(bool on) { m_recordShots = on; }
+		// trajectory file image of the last shot that ended while recording,
+		// from the stroke until the balls came to rest. empty if none
+		const std::vector<unsigned char>& shotTrajectory(void) const { return m_shotTrajectory; }
+
+		World& world(void) { return m_world; }
+		const World& world(void) const { return m_world; }
+		const Replay& replay(void) const { return m_replay; }
+
+		const Rules& rules(void) const { return *m_rules; }
+		int ballCount(void) const { return m_rules->ballCount(); }
+		// ball of the player to shoot
+		int cueBall(void) const { return m_rules->cueBall(m_whiteTurn ? 0 : 1); }
+
+		bool isStopped(void) const { return m_stopped; }
+		bool whiteTurn(void) const { return m_whiteTurn; }
+		int whiteScore(void) const { return m_wScore; }
+		int yellowScore(void) const { return m_yScore; }
+
+	private:
+		void newGame(void);
+		void passTurn(void);
+		Vec2 aimVelocity(void) const;
+
+		const Rules*        m_rules;
+		World               m_world;
+		float               m_rack[MAX_BALLS][2];
+		Replay              m_replay;
+		bool                m_stopped;      // every ball at rest
+		bool                m_shotPending;  // a shot was played and is not scored yet
+		bool                m_whiteTurn;
+		int                 m_wScore;
+		int                 m_yScore;
+		float               m_aimX, m_aimZ;
+		ShotPreview         m_preview;
+		bool                m_previewValid;
+		ShotSearch*         m_search;
+		ShotCache           m_shotCache;    // predictions of aimed shots
+		const ShotPrediction* m_prediction; // of the aim, in m_shotCache
+		bool                m_recordShots;
+		bool                m_recording;    // the pending shot is being recorded
+		TrajectoryWriter    m_track;
+		unsigned int        m_trackStep;    // World::stepIndex of the last sample
+		std::vector<unsigned char> m_shotTrajectory;
+	};
+}
+
+#endif // __tableH__
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: tableServer.cpp
+//
+// Many games stepped on a thread pool. See tableServer.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "tableServer.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <atomic>
+
+namespace sim
+{
+	TableServer::TableServer(ThreadPool& pool, int tableCount, Game game)
+		: m_pool(pool), m_busy(0)
+	{
+		for (int k = 0; k < tableCount; k++)
+			m_slots.push_back(new Slot(game));
+	}
+
+	TableServer::~TableServer(void)
+	{
+		for (size_t k = 0; k < m_slots.size(); k++)
+			delete m_slots[k];
+	}
+
+	void TableServer::post(int k, const TableInput& input)
+	{
+		Slot* s = m_slots[k];
+		std::lock_guard<std::mutex> lk(s->lock);
+		s->inbox.push_back(input);
+	}
+
+	void TableServer::tick(float dt)
+	{
+		int count = tableCount();
+		std::atomic<int> busy(0);
+
+		// many chunks per worker: tables at rest cost almost nothing, tables
+		// mid-shot run the event solver, so the load is uneven
+		int grain = std::max(1, count / (m_pool.size() * 16));
+
+		m_pool.parallelFor(count, grain, [&](int begin, int end, int) {
+			int chunkBusy = 0;
+			for (int k = begin; k < end; k++) {
+				Slot* s = m_slots[k];
+				{
+					std::lock_guard<std::mutex> lk(s->lock);
+					s->work.swap(s->inbox);
+				}
+				for (size_t n = 0; n < s->work.size(); n++)
+					s->table.apply(s->work[n]);
+				s->work.clear();
+
+				s->shotEnded = s->table.step(dt);
+				if (!s->table.isStopped())
+					chunkBusy++;
+			}
+			busy += chunkBusy;
+		});
+		m_busy = busy;
+
+		m_shotEnds.clear();
+		for (int k = 0; k < count; k++) {
+			const Slot* s = m_slots[k];
+			if (!s->shotEnded)
+				continue;
+			ShotEnd e;
+			e.table = k;
+			e.whiteTurn = s->table.whiteTurn();
+			e.whiteScore = s->table.whiteScore();
+			e.yellowScore = s->table.yellowScore();
+			m_shotEnds.push_back(e);
+		}
+	}
+}
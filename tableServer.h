@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: tableServer.h
+//
+// Hosts many games (Tables) in one process. Every table has its own input
+// queue that any thread may post cue/restart commands to; tick() drains the
+// queues and steps every table on a work-stealing ThreadPool. Tables whose
+// balls are at rest sleep (see World::wake), so an idle table costs next to
+// nothing and one host can run thousands of games.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __tableServerH__
+#define __tableServerH__
+
+#include "table.h"
+#include <vector>
+#include <mutex>
+
+namespace sim
+{
+	class ThreadPool;
+
+	// a shot that ended during the last tick, with the turn and scores after it
+	struct ShotEnd {
+		int             table;
+		bool            whiteTurn;
+		int             whiteScore;
+		int             yellowScore;
+	};
+
+	class TableServer {
+	public:
+		// tableCount tables of game, on the standard table
+		TableServer(ThreadPool& pool, int tableCount, Game game = FOUR_BALL);
+		~TableServer(void);
+
+		int tableCount(void) const { return (int)m_slots.size(); }
+		const Table& table(int k) const { return m_slots[k]->table; }
+
+		// play table k on scene from now on, starting a new game (see
+		// Table::load). not while tick() runs
+		bool load(int k, const Scene& scene) { return m_slots[k]->table.load(scene); }
+		// record the shots of every table (Table::recordShots). not while
+		// tick() runs
+		void recordShots(bool on)
+		{
+			for (size_t k = 0; k < m_slots.size(); k++)
+				m_slots[k]->table.recordShots(on);
+		}
+
+		// queue an input for table k. safe to call from any thread, also
+		// while tick() runs; the input is applied at the start of a tick
+		void post(int k, const TableInput& input);
+
+		// apply the queued inputs and advance every table by dt seconds
+		void tick(float dt);
+
+		// shots that ended during the last tick, in table order
+		const std::vector<ShotEnd>& shotEnds(void) const { return m_shotEnds; }
+		// tables with a shot in progress after the last tick
+		int busyCount(void) const { return m_busy; }
+
+	private:
+		struct Slot {
+			explicit Slot(Game game) : table(game), shotEnded(false) {}
+
+			Table                   table;
+			std::mutex              lock;       // guards inbox
+			std::vector<TableInput> inbox;
+			std::vector<TableInput> work;       // inbox taken over by the tick
+			bool                    shotEnded;
+		};
+
+		TableServer(const TableServer&);
+		TableServer& operator=(const TableServer&);
+
+		ThreadPool&                 m_pool;
+		std::vector<Slot*>          m_slots;
+		std::vector<ShotEnd>        m_shotEnds;
+		int                         m_busy;
+	};
+}
+
+#endif // __tableServerH__
@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: tableServerMain.cpp
+//
+// Headless host for a tournament: runs many games in one process and takes
+// their inputs as text lines from a pipe.
+//
+//   tableServer [--tables=<n>] [--rate=<hz>] [--threads=<n>] [--input=<path>]
+//               [--scene=<file>] [--game=<four-ball|three-cushion>]
+//               [--record=<prefix>]
+//
+// Commands are read from stdin, or from path (a named pipe / FIFO a front
+// end writes to), one per line:
+//     <table> cue <vx> <vz>     strike the cue ball of table
+//     <table> restart           back to the opening position
+//     quit
+// Every shot that ends is written to stdout as
+//     <table> shot <white|yellow to play> <white score> <yellow score>
+// Tables are stepped --rate times a second (0: as fast as possible). The
+// server stops after quit, or at the end of the input once every table is
+// at rest. Every table plays --game (rules.h), four-ball unless given.
+// With --scene, every table plays on the layout of a scene file (scene.h)
+// holding the balls of the game instead of the standard table.
+// With --record, the ball paths of every shot are written for review to
+// <prefix><table>-<shot>.vltr (trajectory.h), shots counted per table
+// from 1.
+//
+// Built as the tableServer target of CMakeLists.txt.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "tableServer.h"
+#include "threadPool.h"
+#include "scene.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace sim;
+
+static std::atomic<bool> g_inputDone(false);
+
+// feeds the table queues from in until quit or the end of the input
+static void readInput(FILE* in, TableServer* server)
+{
+	char line[256];
+	while (fgets(line, sizeof(line), in) != NULL) {
+		int table;
+		char cmd[16];
+		float vx, vz;
+		if (strncmp(line, "quit", 4) == 0)
+			break;
+		int fields = sscanf(line, "%d %15s %f %f", &table, cmd, &vx, &vz);
+		if (fields < 2 || table < 0 || table >= server->tableCount()) {
+			fprintf(stderr, "bad command: %s", line);
+			continue;
+		}
+
+		TableInput input;
+		input.x = input.z = 0;
+		// sscanf reads nan and inf as numbers, which Table::shoot refuses
+		if (strcmp(cmd, "cue") == 0 && fields == 4 && std::isfinite(vx) && std::isfinite(vz)) {
+			input.type = TableInput::CUE;
+			input.x = vx;
+			input.z = vz;
+		}
+		else if (strcmp(cmd, "restart") == 0)
+			input.type = TableInput::RESTART;
+		else {
+			fprintf(stderr, "bad command: %s", line);
+			continue;
+		}
+		server->post(table, input);
+	}
+	g_inputDone = true;
+}
+
+static bool writeFile(const char* path, const std::vector<unsigned char>& image)
+{
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+		return false;
+	bool ok = image.empty() || fwrite(&image[0], 1, image.size(), fp) == image.size();
+	return fclose(fp) == 0 && ok;
+}
+
+int main(int argc, char** argv)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	int tables = 1000;
+	int threads = 0;
+	double rate = 120;
+	const char* inputPath = NULL;
+	const char* scenePath = NULL;
+	const char* recordPrefix = NULL;
+	Game game = FOUR_BALL;
+
+	for (int a = 1; a < argc; a++) {
+		if (strncmp(argv[a], "--tables=", 9) == 0)
+			tables = atoi(argv[a] + 9);
+		else if (strncmp(argv[a], "--rate=", 7) == 0)
+			rate = atof(argv[a] + 7);
+		else if (strncmp(argv[a], "--threads=", 10) == 0)
+			threads = atoi(argv[a] + 10);
+		else if (strncmp(argv[a], "--input=", 8) == 0)
+			inputPath = argv[a] + 8;
+		else if (strncmp(argv[a], "--scene=", 8) == 0)
+			scenePath = argv[a] + 8;
+		else if (strncmp(argv[a], "--record=", 9) == 0)
+			recordPrefix = argv[a] + 9;
+		else if (strncmp(argv[a], "--game=", 7) == 0) {
+			if (!gameNamed(argv[a] + 7, game)) {
+				fprintf(stderr, "unknown game %s\n", argv[a] + 7);
+				return 2;
+			}
+		}
+		else {
+			fprintf(stderr, "usage: %s [--tables=<n>] [--rate=<hz>] [--threads=<n>] [--input=<path>] [--scene=<file>]\n"
+				"       [--game=<four-ball|three-cushion>] [--record=<prefix>]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (tables < 1) {
+		fprintf(stderr, "need at least one table\n");
+		return 2;
+	}
+
+	Scene scene;
+	if (scenePath != NULL && !scene.open(scenePath)) {
+		fprintf(stderr, "cannot load scene %s\n", scenePath);
+		return 1;
+	}
+
+	FILE* in = stdin;
+	if (inputPath != NULL && (in = fopen(inputPath, "r")) == NULL) {
+		fprintf(stderr, "cannot open %s\n", inputPath);
+		return 1;
+	}
+
+	ThreadPool pool(threads);
+	TableServer server(pool, tables, game);
+	for (int k = 0; scene.isOpen() && k < tables; k++) {
+		if (!server.load(k, scene)) {
+			fprintf(stderr, "scene %s does not hold a %s rack\n", scenePath, rulesFor(game).name());
+			return 1;
+		}
+	}
+	std::vector<int> shotsRecorded(tables, 0);
+	if (recordPrefix != NULL)
+		server.recordShots(true);
+	std::thread reader(readInput, in, &server);
+
+	// the tables always advance by the same dt, so a game comes out the
+	// same whatever the rate
+	const float dt = 1.0f / 120;
+	Clock::duration period = rate > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / rate))
+		: Clock::duration::zero();
+	Clock::time_point start = Clock::now(), next = start;
+	long long ticks = 0;
+	double busyTicks = 0;
+
+	for (;;) {
+		// read before the tick: inputs posted after this are picked up next time
+		bool done = g_inputDone;
+		server.tick(dt);
+		ticks++;
+		busyTicks += server.busyCount();
+
+		const std::vector<ShotEnd>& ends = server.shotEnds();
+		for (size_t k = 0; k < ends.size(); k++) {
+			printf("%d shot %s %d %d\n", ends[k].table, ends[k].whiteTurn ? "white" : "yellow",
+				ends[k].whiteScore, ends[k].yellowScore);
+			if (recordPrefix != NULL) {
+				int t = ends[k].table;
+				std::string path = std::string(recordPrefix) + std::to_string(t) + "-"
+					+ std::to_string(++shotsRecorded[t]) + ".vltr";
+				if (!writeFile(path.c_str(), server.table(t).shotTrajectory()))
+					fprintf(stderr, "cannot write %s\n", path.c_str());
+			}
+		}
+		if (!ends.empty())
+			fflush(stdout);
+
+		if (done && server.busyCount() == 0)
+			break;
+		if (period > Clock::duration::zero()) {
+			next += period;
+			std::this_thread::sleep_until(next);
+		}
+	}
+
+	reader.join();
+	if (in != stdin)
+		fclose(in);
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	fprintf(stderr, "%d tables, %lld ticks in %.2f s (%.3f ms/tick, %.1f tables busy on average)\n",
+		tables, ticks, seconds, seconds * 1000 / ticks, busyTicks / ticks);
+	return 0;
+}
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: threadPool.cpp
+//
+// Work-stealing thread pool. See threadPool.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "threadPool.h"
+#include <algorithm>
+
+namespace sim
+{
+	ThreadPool::ThreadPool(int threads)
+	{
+		if (threads <= 0)
+			threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+		m_queued = 0;
+		m_quit = false;
+		for (int i = 0; i < threads; i++)
+			m_workers.push_back(new Worker);
+		for (int i = 0; i < threads; i++)
+			m_threads.push_back(std::thread(&ThreadPool::run, this, i));
+	}
+
+	ThreadPool::~ThreadPool(void)
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_wakeLock);
+			m_quit = true;
+		}
+		m_wake.notify_all();
+		for (size_t i = 0; i < m_threads.size(); i++)
+			m_threads[i].join();
+		for (size_t i = 0; i < m_workers.size(); i++)
+			delete m_workers[i];
+	}
+
+	void ThreadPool::parallelFor(int count, int grain, const RangeFn& fn)
+	{
+		if (count <= 0)
+			return;
+		grain = std::max(1, grain);
+
+		Job job;
+		job.fn = &fn;
+		job.pending = (count + grain - 1) / grain;
+
+		int worker = 0;
+		for (int begin = 0; begin < count; begin += grain) {
+			Task task = { begin, std::min(begin + grain, count), &job };
+			Worker* w = m_workers[worker];
+			{
+				std::lock_guard<std::mutex> lk(w->lock);
+				w->tasks.push_back(task);
+			}
+			worker = (worker + 1) % size();
+		}
+		{
+			std::lock_guard<std::mutex> lk(m_wakeLock);
+			m_queued += job.pending;
+		}
+		m_wake.notify_all();
+
+		std::unique_lock<std::mutex> lk(m_doneLock);
+		while (job.pending != 0)
+			m_done.wait(lk);
+	}
+
+	bool ThreadPool::pop(int index, Task& task)
+	{
+		Worker* w = m_workers[index];
+		std::lock_guard<std::mutex> lk(w->lock);
+		if (w->tasks.empty())
+			return false;
+		task = w->tasks.back();
+		w->tasks.pop_back();
+		return true;
+	}
+
+	bool ThreadPool::steal(int index, Task& task)
+	{
+		for (int k = 1; k < size(); k++) {
+			Worker* w = m_workers[(index + k) % size()];
+			std::lock_guard<std::mutex> lk(w->lock);
+			if (!w->tasks.empty()) {
+				task = w->tasks.front();
+				w->tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadPool::finish(Job* job)
+	{
+		if (--job->pending == 0) {
+			std::lock_guard<std::mutex> lk(m_doneLock);
+			m_done.notify_all();
+		}
+	}
+
+	void ThreadPool::run(int index)
+	{
+		for (;;) {
+			Task task;
+			if (pop(index, task) || steal(index, task)) {
+				m_queued--;
+				(*task.job->fn)(task.begin, task.end, index);
+				finish(task.job);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lk(m_wakeLock);
+			while (!m_quit && m_queued == 0)
+				m_wake.wait(lk);
+			if (m_quit)
+				return;
+		}
+	}
+}
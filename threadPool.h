@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: threadPool.h
+//
+// Work-stealing thread pool used by the headless batch tools.
+// parallelFor() cuts a range into chunks and deals them round-robin onto the
+// workers' own deques. A worker pops from the back of its own deque and, when
+// that runs dry, steals from the front of the others, so uneven chunks (long
+// and short shots) still keep every core busy.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __threadPoolH__
+#define __threadPoolH__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace sim
+{
+	class ThreadPool {
+	public:
+		// fn(begin, end, worker) handles [begin, end); worker is in [0, size())
+		typedef std::function<void(int, int, int)> RangeFn;
+
+		// threads <= 0 uses one worker per hardware thread
+		explicit ThreadPool(int threads = 0);
+		~ThreadPool(void);
+
+		int size(void) const { return (int)m_threads.size(); }
+
+		// run fn over [0, count) in chunks of at most grain and wait for all
+		// of them. must not be called from inside fn
+		void parallelFor(int count, int grain, const RangeFn& fn);
+
+	private:
+		struct Job {
+			const RangeFn*      fn;
+			std::atomic<int>    pending;
+		};
+
+		struct Task {
+			int     begin, end;
+			Job*    job;
+		};
+
+		struct Worker {
+			std::mutex          lock;
+			std::deque<Task>    tasks;
+		};
+
+		ThreadPool(const ThreadPool&);
+		ThreadPool& operator=(const ThreadPool&);
+
+		void run(int index);
+		bool pop(int index, Task& task);
+		bool steal(int index, Task& task);
+		void finish(Job* job);
+
+		std::vector<Worker*>        m_workers;
+		std::vector<std::thread>    m_threads;
+
+		std::mutex                  m_wakeLock;
+		std::condition_variable     m_wake;
+		std::atomic<int>            m_queued;
+		bool                        m_quit;
+
+		std::mutex                  m_doneLock;
+		std::condition_variable     m_done;
+	};
+}
+
+#endif // __threadPoolH__
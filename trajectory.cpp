@@ -0,0 +1,425 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: trajectory.cpp
+//
+// Recorded ball trajectories. See trajectory.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "trajectory.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace sim
+{
+	static const char TRAJECTORY_MAGIC[4] = { 'V', 'L', 'T', 'R' };
+	static const unsigned int TRAJECTORY_VERSION = 1;
+
+	// the change of a ball that fits one token byte
+	static const int NIBBLE_MAX = 7;
+
+	static int quantize(float v, float quantum)
+	{
+		return (int)std::floor(v / quantum + 0.5f);
+	}
+
+	// -------------------------------------------------------------------------
+	// TrajectoryWriter
+	// -------------------------------------------------------------------------
+
+	TrajectoryWriter::TrajectoryWriter(void)
+	{
+		m_run = 0;
+		m_sampleCount = 0;
+		m_ballCount = 0;
+		m_keyInterval = 1;
+		m_sampleInterval = 0;
+		m_quantum = 1;
+		m_game = FOUR_BALL;
+		m_finished = true;
+	}
+
+	void TrajectoryWriter::begin(const World& world, Game game, float sampleInterval, float quantum, int keyInterval)
+	{
+		if (world.ballCount() > MAX_BALLS) {
+			m_image.clear();
+			m_sampleCount = 0;
+			m_finished = true;
+			return;
+		}
+		m_image.assign(sizeof(TrajectoryHeader), 0);
+		m_index.clear();
+		m_run = 0;
+		m_sampleCount = 0;
+		m_ballCount = world.ballCount();
+		m_keyInterval = keyInterval > 0 ? keyInterval : 1;
+		m_sampleInterval = sampleInterval;
+		m_quantum = quantum;
+		m_game = game;
+		m_finished = false;
+		m_pos.assign(2 * m_ballCount, 0);
+		m_vel.assign(2 * m_ballCount, 0);
+		m_last.resize(2 * m_ballCount);
+		for (int i = 0; i < m_ballCount; i++) {
+			m_last[2 * i] = (float)world.getCenter(i).x;
+			m_last[2 * i + 1] = (float)world.getCenter(i).z;
+		}
+		addSample(&m_last[0]);
+	}
+
+	void TrajectoryWriter::add(const World& world, int steps)
+	{
+		if (m_finished || steps <= 0)
+			return;
+		m_fill.resize(2 * m_ballCount);
+		for (int s = 1; s <= steps; s++) {
+			float t = (float)s / (float)steps;
+			for (int i = 0; i < m_ballCount; i++) {
+				Vec2 c = world.getCenter(i);
+				m_fill[2 * i] = s == steps ? (float)c.x : m_last[2 * i] + ((float)c.x - m_last[2 * i]) * t;
+				m_fill[2 * i + 1] = s == steps ? (float)c.z : m_last[2 * i + 1] + ((float)c.z - m_last[2 * i + 1]) * t;
+			}
+			addSample(&m_fill[0]);
+		}
+		m_last.swap(m_fill);
+	}
+
+	void TrajectoryWriter::putVarint(unsigned int v)
+	{
+		while (v >= 0x80) {
+			put((unsigned char)(v | 0x80));
+			v >>= 7;
+		}
+		put((unsigned char)v);
+	}
+
+	void TrajectoryWriter::putZigzag(int v)
+	{
+		putVarint(((unsigned int)v << 1) ^ (unsigned int)(v >> 31));
+	}
+
+	void TrajectoryWriter::flushRun(void)
+	{
+		if (m_run == 1)
+			put(0x00);
+		else if (m_run >= 2 && m_run <= 15)
+			put((unsigned char)(0x80 | (m_run - 1)));
+		else if (m_run >= 16) {
+			put(0x8f);
+			putVarint(m_run - 16);
+		}
+		m_run = 0;
+	}
+
+	void TrajectoryWriter::addSample(const float* centers)
+	{
+		const int n = 2 * m_ballCount;
+		if (m_sampleCount % m_keyInterval == 0) {
+			flushRun();
+			m_index.push_back((unsigned int)m_image.size());
+			for (int k = 0; k < n; k++) {
+				m_pos[k] = quantize(centers[k], m_quantum);
+				m_vel[k] = 0;
+				putZigzag(m_pos[k]);
+			}
+			m_sampleCount++;
+			return;
+		}
+
+		for (int k = 0; k < n; k += 2) {
+			int qx = quantize(centers[k], m_quantum), qz = quantize(centers[k + 1], m_quantum);
+			int dx = qx - m_pos[k] - m_vel[k], dz = qz - m_pos[k + 1] - m_vel[k + 1];
+			m_vel[k] += dx;
+			m_vel[k + 1] += dz;
+			m_pos[k] = qx;
+			m_pos[k + 1] = qz;
+
+			if (dx == 0 && dz == 0) {
+				m_run++;
+				continue;
+			}
+			flushRun();
+			if (dx >= -NIBBLE_MAX && dx <= NIBBLE_MAX && dz >= -NIBBLE_MAX && dz <= NIBBLE_MAX)
+				put((unsigned char)(((dx & 15) << 4) | (dz & 15)));
+			else {
+				put(0x80);
+				putZigzag(dx);
+				putZigzag(dz);
+			}
+		}
+		m_sampleCount++;
+	}
+
+	const std::vector<unsigned char>& TrajectoryWriter::finish(void)
+	{
+		if (m_finished)
+			return m_image;
+		m_finished = true;
+		flushRun();
+		unsigned int dataEnd = (unsigned int)m_image.size();
+		m_image.resize((dataEnd + 3) & ~3u, 0);
+
+		TrajectoryHeader h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, TRAJECTORY_MAGIC, 4);
+		h.version = TRAJECTORY_VERSION;
+		h.game = (unsigned int)m_game;
+		h.ballCount = (unsigned int)m_ballCount;
+		h.sampleCount = (unsigned int)m_sampleCount;
+		h.sampleInterval = m_sampleInterval;
+		h.quantum = m_quantum;
+		h.keyInterval = (unsigned int)m_keyInterval;
+		h.keyCount = (unsigned int)m_index.size();
+		h.indexOffset = (unsigned int)m_image.size();
+		h.dataOffset = (unsigned int)sizeof(TrajectoryHeader);
+
+		// the host lays out the header and index as the file does on a
+		// little-endian host
+		size_t indexBytes = m_index.size() * sizeof(unsigned int);
+		m_image.resize(h.indexOffset + indexBytes);
+		if (indexBytes > 0)
+			memcpy(&m_image[h.indexOffset], &m_index[0], indexBytes);
+		h.size = (unsigned int)m_image.size();
+		memcpy(&m_image[0], &h, sizeof(h));
+		return m_image;
+	}
+
+	bool TrajectoryWriter::save(const char* path)
+	{
+		const std::vector<unsigned char>& image = finish();
+		if (image.empty())
+			return false;
+		FILE* fp = fopen(path, "wb");
+		if (fp == NULL)
+			return false;
+		bool ok = fwrite(&image[0], 1, image.size(), fp) == image.size();
+		return fclose(fp) == 0 && ok;
+	}
+
+	// -------------------------------------------------------------------------
+	// Trajectory
+	// -------------------------------------------------------------------------
+
+	Trajectory::Trajectory(void)
+	{
+		m_header = NULL;
+		m_base = NULL;
+		m_index = NULL;
+		m_sample = -1;
+		m_read = m_end = NULL;
+		m_run = 0;
+		m_prevValid = false;
+	}
+
+	Trajectory::~Trajectory(void)
+	{
+		close();
+	}
+
+	bool Trajectory::open(const char* path)
+	{
+		close();
+		FILE* fp = fopen(path, "rb");
+		if (fp == NULL)
+			return false;
+		std::vector<unsigned char> data;
+		unsigned char buf[4096];
+		size_t got;
+		while ((got = fread(buf, 1, sizeof(buf), fp)) > 0)
+			data.insert(data.end(), buf, buf + got);
+		fclose(fp);
+
+		std::vector<unsigned int> file((data.size() + 3) / 4);
+		if (!data.empty())
+			memcpy(&file[0], &data[0], data.size());
+		if (file.empty() || !view(&file[0], data.size()))
+			return false;
+		// a swap keeps the buffer the header points into
+		m_file.swap(file);
+		return true;
+	}
+
+	// only the header is checked, which costs the same for every file; a
+	// span is checked as it is decoded
+	bool Trajectory::view(const void* data, size_t size)
+	{
+		close();
+		const TrajectoryHeader* h = (const TrajectoryHeader*)data;
+		if (data == NULL || ((size_t)data & 3) != 0 || size < sizeof(TrajectoryHeader))
+			return false;
+		if (memcmp(h->magic, TRAJECTORY_MAGIC, 4) != 0 || h->version != TRAJECTORY_VERSION || h->size != size)
+			return false;
+		// a keyframe takes a byte per coordinate at least, so no file asks
+		// for more memory than it is big
+		if (h->game >= GAME_COUNT || h->ballCount == 0 || h->ballCount > TrajectoryWriter::MAX_BALLS
+			|| 2 * h->ballCount > size || h->sampleCount == 0 || h->keyInterval == 0
+			|| !(h->sampleInterval > 0) || !(h->quantum > 0))
+			return false;
+		if (h->keyCount != (h->sampleCount - 1) / h->keyInterval + 1 || h->dataOffset < sizeof(TrajectoryHeader)
+			|| h->indexOffset % 4 != 0 || h->indexOffset > size
+			|| (unsigned long long)h->keyCount * 4 != size - h->indexOffset)
+			return false;
+
+		m_header = h;
+		m_base = (const unsigned char*)data;
+		m_index = (const unsigned int*)(m_base + h->indexOffset);
+		m_sample = -1;
+		m_pos.assign(2 * h->ballCount, 0);
+		m_vel.assign(2 * h->ballCount, 0);
+		m_prev.assign(2 * h->ballCount, 0);
+		m_prevValid = false;
+		return true;
+	}
+
+	void Trajectory::close(void)
+	{
+		m_file.clear();
+		m_header = NULL;
+		m_base = NULL;
+		m_index = NULL;
+		m_sample = -1;
+	}
+
+	bool Trajectory::getVarint(unsigned int& v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 32; shift += 7) {
+			if (m_read >= m_end)
+				return false;
+			unsigned char b = *m_read++;
+			v |= (unsigned int)(b & 0x7f) << shift;
+			if (b < 0x80)
+				return true;
+		}
+		return false;
+	}
+
+	bool Trajectory::getZigzag(int& v)
+	{
+		unsigned int u;
+		if (!getVarint(u))
+			return false;
+		v = (int)(u >> 1) ^ -(int)(u & 1);
+		return true;
+	}
+
+	// decoder at sample s: from where it is when s lies ahead of it in the
+	// same span, else from the keyframe of s
+	bool Trajectory::seek(int s)
+	{
+		const int key = s / (int)m_header->keyInterval;
+		if (m_sample < 0 || m_sample > s || m_sample / (int)m_header->keyInterval != key) {
+			unsigned int begin = m_index[key];
+			unsigned int end = key + 1 < (int)m_header->keyCount ? m_index[key + 1] : m_header->indexOffset;
+			if (begin < m_header->dataOffset || begin > end || end > m_header->indexOffset)
+				return false;
+			m_read = m_base + begin;
+			m_end = m_base + end;
+			m_run = 0;
+			m_sample = -1;
+			m_prevValid = false;
+			for (size_t k = 0; k < m_pos.size(); k++) {
+				if (!getZigzag(m_pos[k]))
+					return false;
+				m_vel[k] = 0;
+			}
+			m_sample = key * (int)m_header->keyInterval;
+		}
+		while (m_sample < s) {
+			// only the sample before s is kept, for at()
+			if (m_sample == s - 1) {
+				m_prev = m_pos;
+				m_prevValid = true;
+			}
+			if (!decodeSample()) {
+				m_sample = -1;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Trajectory::decodeSample(void)
+	{
+		for (size_t k = 0; k < m_pos.size(); k += 2) {
+			int dx = 0, dz = 0;
+			if (m_run > 0)
+				m_run--;
+			else {
+				if (m_read >= m_end)
+					return false;
+				unsigned char b = *m_read++;
+				int hi = b >> 4, lo = b & 15;
+				if (hi != 8) {
+					dx = hi > NIBBLE_MAX ? hi - 16 : hi;
+					dz = lo > NIBBLE_MAX ? lo - 16 : lo;
+				}
+				else if (lo == 0) {
+					if (!getZigzag(dx) || !getZigzag(dz))
+						return false;
+				}
+				else if (lo < 15)
+					m_run = (unsigned int)lo;       // this ball and lo more
+				else {
+					unsigned int n;
+					if (!getVarint(n))
+						return false;
+					m_run = n + 15;
+				}
+			}
+			m_vel[k] += dx;
+			m_vel[k + 1] += dz;
+			m_pos[k] += m_vel[k];
+			m_pos[k + 1] += m_vel[k + 1];
+		}
+		m_sample++;
+		return true;
+	}
+
+	void Trajectory::store(const std::vector<int>& pos, float* centers) const
+	{
+		for (size_t k = 0; k < pos.size(); k++)
+			centers[k] = (float)pos[k] * m_header->quantum;
+	}
+
+	bool Trajectory::sample(int s, float* centers)
+	{
+		if (!isOpen() || s < 0 || s >= sampleCount() || !seek(s))
+			return false;
+		store(m_pos, centers);
+		return true;
+	}
+
+	bool Trajectory::at(double time, float* centers)
+	{
+		if (!isOpen())
+			return false;
+		double u = time / sampleInterval();
+		u = u < 0 ? 0 : (u > sampleCount() - 1 ? sampleCount() - 1 : u);
+		int s = (int)u;
+		float t = (float)(u - s);
+		if (t == 0 || s + 1 >= sampleCount())
+			return sample(s, centers);
+
+		// the decoder goes to s + 1 and sample s is the one it passed on
+		// the way, so playing forward decodes each sample once. only when
+		// s + 1 opens a span is s decoded apart, from its own keyframe
+		if (m_sample == s) {
+			store(m_pos, centers);
+			if (!seek(s + 1))
+				return false;
+		}
+		else {
+			if (!seek(s + 1))
+				return false;
+			if (m_prevValid)
+				store(m_prev, centers);
+			else if (!sample(s, centers) || !seek(s + 1))
+				return false;
+		}
+		for (size_t k = 0; k < m_pos.size(); k++)
+			centers[k] += ((float)m_pos[k] * m_header->quantum - centers[k]) * t;
+		return true;
+	}
+}
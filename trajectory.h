@@ -0,0 +1,157 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: trajectory.h
+//
+// Recorded ball trajectories of a shot, for review. Every ball center is
+// sampled at a fixed interval and rounded to a grid (the quantum), and a
+// sample is stored as how far each ball strays from moving on at its last
+// velocity: zero for a ball at rest or rolling straight on, small while it
+// slows down, large only at impacts. Those are packed a few bits each, and
+// runs of zeros take one token, so a shot costs about a byte per moving
+// ball and sample against 8 for raw floats, and next to nothing for balls
+// at rest.
+// Every keyInterval samples a keyframe stores the centers outright and an
+// index holds the offset of every keyframe, so reaching any time decodes
+// at most one keyframe span, however long the recording. A Trajectory
+// keeps its place and the sample before it, so playing or scrubbing
+// forward from it only decodes the samples in between. It reads a file whole, or views an image in
+// memory (TrajectoryWriter::finish) without a copy.
+//
+// Layout (little endian, read in place, so little-endian hosts only):
+//     TrajectoryHeader, then the keyframe spans from dataOffset on, then
+//     at indexOffset u32[keyCount], the offset of every span.
+//     A span opens with the ballCount centers of its first sample, x then
+//     z, as zigzag varints in quanta. Every later sample of the span holds,
+//     ball by ball, the change (dx, dz) of the ball's velocity in quanta
+//     per sample, as tokens:
+//         byte, high nibble not 8   dx and dz as signed nibbles, -7 ~ 7
+//         0x80                      escape: dx and dz follow as zigzag varints
+//         0x81 ~ 0x8e               2 ~ 15 zero changes in a row
+//         0x8f                      a varint n follows: n + 16 zero changes
+//     Runs go on across samples but not across spans. A span starts with
+//     every ball at rest.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __trajectoryH__
+#define __trajectoryH__
+
+#include "billiardSim.h"
+#include "rules.h"
+#include <cstddef>
+#include <vector>
+
+namespace sim
+{
+	struct TrajectoryHeader {
+		char            magic[4];       // "VLTR"
+		unsigned int    version;
+		unsigned int    size;           // bytes of the whole file
+		unsigned int    game;           // Game the balls are colored for
+		unsigned int    ballCount;
+		unsigned int    sampleCount;
+		float           sampleInterval; // seconds
+		float           quantum;        // table units of one step of a stored center
+		unsigned int    keyInterval;    // samples of a keyframe span
+		unsigned int    keyCount, indexOffset;
+		unsigned int    dataOffset;
+	};
+
+	class TrajectoryWriter {
+	public:
+		// the most balls a recording holds
+		enum { MAX_BALLS = 1024 };
+
+		TrajectoryWriter(void);
+
+		// start recording the balls of world, played under game: a sample
+		// every sampleInterval seconds, centers rounded to quantum and a
+		// keyframe every keyInterval samples. the first sample is world as
+		// it is. a world of more than MAX_BALLS balls records nothing
+		void begin(const World& world, Game game, float sampleInterval, float quantum = 1.0f / 1024, int keyInterval = 64);
+		// world steps samples after the last sample. the samples in between
+		// are filled in on a straight line
+		void add(const World& world, int steps = 1);
+		int sampleCount(void) const { return m_sampleCount; }
+
+		// the file image of the recording, empty when nothing was recorded.
+		// nothing can be added after it until the next begin()
+		const std::vector<unsigned char>& finish(void);
+		bool save(const char* path);
+
+	private:
+		void addSample(const float* centers);
+		void put(unsigned char byte) { m_image.push_back(byte); }
+		void putVarint(unsigned int v);
+		void putZigzag(int v);
+		void flushRun(void);
+
+		std::vector<unsigned char>  m_image;        // header space, then the spans
+		std::vector<unsigned int>   m_index;
+		std::vector<int>            m_pos, m_vel;   // quanta, 2 per ball
+		std::vector<float>          m_last;         // centers of the last sample
+		std::vector<float>          m_fill;
+		unsigned int                m_run;          // zero changes not written yet
+		int                         m_sampleCount;
+		int                         m_ballCount;
+		int                         m_keyInterval;
+		float                       m_sampleInterval;
+		float                       m_quantum;
+		Game                        m_game;
+		bool                        m_finished;
+	};
+
+	class Trajectory {
+	public:
+		Trajectory(void);
+		~Trajectory(void);
+
+		// read the trajectory file at path. false, leaving it empty, when
+		// it cannot be read or is not a valid trajectory
+		bool open(const char* path);
+		// use the size bytes at data as a trajectory file, without a copy.
+		// data must be 4-byte aligned and stay as it is while it is open
+		bool view(const void* data, size_t size);
+		void close(void);
+		bool isOpen(void) const { return m_header != NULL; }
+
+		Game game(void) const { return (Game)m_header->game; }
+		int ballCount(void) const { return (int)m_header->ballCount; }
+		int sampleCount(void) const { return (int)m_header->sampleCount; }
+		float sampleInterval(void) const { return m_header->sampleInterval; }
+		double duration(void) const { return (double)(sampleCount() - 1) * sampleInterval(); }
+
+		// the centers of sample s, (x, z) per ball into centers. false when
+		// s is out of range or the data is broken
+		bool sample(int s, float* centers);
+		// the centers at time seconds from the start, between the samples
+		// around it. clamped to the recording
+		bool at(double time, float* centers);
+
+	private:
+		Trajectory(const Trajectory&);
+		Trajectory& operator=(const Trajectory&);
+
+		bool seek(int s);
+		bool decodeSample(void);
+		void store(const std::vector<int>& pos, float* centers) const;
+		bool getVarint(unsigned int& v);
+		bool getZigzag(int& v);
+
+		const TrajectoryHeader*     m_header;
+		const unsigned char*        m_base;
+		const unsigned int*         m_index;
+		std::vector<unsigned int>   m_file;         // contents of open()
+
+		// decoder place: the sample last decoded and its state
+		int                         m_sample;       // -1 when there is none
+		const unsigned char*        m_read;
+		const unsigned char*        m_end;          // of the span
+		unsigned int                m_run;
+		std::vector<int>            m_pos, m_vel;
+		std::vector<int>            m_prev;         // centers of sample m_sample - 1
+		bool                        m_prevValid;    // m_prev holds them: m_sample is not a keyframe
+	};
+}
+
+#endif // __trajectoryH__
@@ -11,10 +11,15 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "d3dUtility.h"
+#include "simThread.h"
+#include "profiler.h"
+#include "trajectory.h"
+#include <string>
 #include <vector>
 #include <ctime>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 
 IDirect3DDevice9* Device = NULL;
@@ -23,11 +28,16 @@ IDirect3DDevice9* Device = NULL;
 const int Width = 1600;
 const int Height = 900;
 
-// There are four balls
-// initialize the position (coordinate) of each ball (ball0 ~ ball3)
-const float spherePos[4][2] = { { -2.7f, 0 }, { +2.4f, 0 }, { 3.3f, 0 }, { -2.7f, -1.0f } }; // 초기 공 위치 설정, 순서대로  처음 빨간공, 두번째 빨간공, 노란공, 흰공
-// initialize the color of each ball (ball0 ~ ball3)
-const D3DXCOLOR sphereColor[4] = { d3d::RED, d3d::RED, d3d::YELLOW, d3d::WHITE }; // 공 색 지정
+// The balls are placed at the rack of the game (sim::Rules::rack)
+// color of each ball: the players' balls are white and yellow, the others red
+D3DXCOLOR ballColor(const sim::Rules& rules, int i)
+{
+	if (i == rules.cueBall(0))
+		return d3d::WHITE;
+	if (i == rules.cueBall(1))
+		return d3d::YELLOW;
+	return d3d::RED;
+}
 
 
 // -----------------------------------------------------------------------------
@@ -37,187 +47,345 @@ D3DXMATRIX g_mWorld;
 D3DXMATRIX g_mView;
 D3DXMATRIX g_mProj;
 
-#define M_RADIUS 0.21   // ball radius
 #define PI 3.14159265
 #define M_HEIGHT 0.01
-#define DECREASE_RATE 0.9982
 
 // -----------------------------------------------------------------------------
-// CSphere class definition
+// CSphereBatch class definition
 // -----------------------------------------------------------------------------
 
-class CSphere {
-private:
-	float               center_x, center_y, center_z;
-	float                   m_radius;
-	float               m_velocity_x;
-	float               m_velocity_z;
-
+// every ball is the same sphere, so one mesh is shared by all of them and the
+// whole set is drawn with a single instanced call. the world transform and
+// colour of each ball come from a second vertex stream; a small SM3 shader
+// does the lighting the fixed pipeline did for the one point light.
+// devices without SM3 fall back to one DrawSubset per ball on the same mesh.
+//
+// the shared mesh exists in a few tessellation levels, built once. each frame
+// a ball takes the coarsest level whose silhouette stays within half a pixel
+// of a true circle at its projected size, so the switch cannot be seen; one
+// instanced call is made per level in use.
+
+// slices (= stacks) of each level, finest first
+static const int g_lodSlices[] = { 50, 32, 20, 12, 8 };
+static const int LOD_LEVELS = sizeof(g_lodSlices) / sizeof(g_lodSlices[0]);
+
+static const char* g_sphereVS =
+	"float4x4 g_viewProj;\n"
+	"float3 g_lightPos;\n"
+	"float3 g_eyePos;\n"
+	"struct VS_IN { float3 pos : POSITION; float3 nrm : NORMAL;\n"
+	"    float4 m0 : TEXCOORD1; float4 m1 : TEXCOORD2; float4 m2 : TEXCOORD3; float4 m3 : TEXCOORD4;\n"
+	"    float4 color : COLOR0; };\n"
+	"struct VS_OUT { float4 pos : POSITION; float4 color : COLOR0; };\n"
+	"VS_OUT main(VS_IN i)\n"
+	"{\n"
+	"    VS_OUT o;\n"
+	"    float4x4 world = float4x4(i.m0, i.m1, i.m2, i.m3);\n"
+	"    float4 wp = mul(float4(i.pos, 1), world);\n"
+	"    float3 n = normalize(mul(i.nrm, (float3x3)world));\n"
+	"    float3 l = g_lightPos - wp.xyz;\n"
+	"    float d = length(l);\n"
+	"    l /= d;\n"
+	"    float atten = 1 / (0.9 * d);\n"
+	"    float3 h = normalize(l + normalize(g_eyePos - wp.xyz));\n"
+	"    float diffuse = saturate(dot(n, l));\n"
+	"    float spec = pow(saturate(dot(n, h)), 5) * 0.9;\n"
+	"    o.pos = mul(wp, g_viewProj);\n"
+	"    o.color = float4(i.color.rgb * (0.9 + diffuse + spec) * atten, i.color.a);\n"
+	"    return o;\n"
+	"}\n";
+
+static const char* g_spherePS =
+	"float4 main(float4 color : COLOR0) : COLOR { return color; }\n";
+
+class CSphereBatch {
 public:
-	CSphere(void)
+	CSphereBatch(void)
 	{
-		D3DXMatrixIdentity(&m_mLocal);
-		ZeroMemory(&m_mtrl, sizeof(m_mtrl));
+		for (int k = 0; k < LOD_LEVELS; k++)
+			m_pMesh[k] = NULL;
 		m_radius = 0;
-		m_velocity_x = 0;
-		m_velocity_z = 0;
-		m_pSphereMesh = NULL;
+		m_pInstanceVB = NULL;
+		m_pDecl = NULL;
+		m_pVS = NULL;
+		m_pPS = NULL;
+		m_pConstants = NULL;
+		m_capacity = 0;
 	}
-	~CSphere(void) {}
+	~CSphereBatch(void) {}
 
-public:
-	bool create(IDirect3DDevice9* pDevice, D3DXCOLOR color = d3d::WHITE)
+	bool create(IDirect3DDevice9* pDevice, float radius, int capacity)
 	{
 		if (NULL == pDevice)
 			return false;
+		for (int k = 0; k < LOD_LEVELS; k++) {
+			if (FAILED(D3DXCreateSphere(pDevice, radius, g_lodSlices[k], g_lodSlices[k], &m_pMesh[k], NULL)))
+				return false;
+		}
+		m_radius = radius;
+		m_capacity = capacity;
+		m_instances.reserve(capacity);
+		m_sorted.resize(capacity);
+		m_level.resize(capacity);
+		m_lastLevel.assign(capacity, 0);
+
+		// instancing needs vs_3_0; without it every ball is drawn on its own
+		D3DCAPS9 caps;
+		pDevice->GetDeviceCaps(&caps);
+		if (caps.VertexShaderVersion < D3DVS_VERSION(3, 0) || caps.PixelShaderVersion < D3DPS_VERSION(3, 0))
+			return true;
 
-		m_mtrl.Ambient = color;
-		m_mtrl.Diffuse = color;
-		m_mtrl.Specular = color;
-		m_mtrl.Emissive = d3d::BLACK;
-		m_mtrl.Power = 5.0f;
-
-		if (FAILED(D3DXCreateSphere(pDevice, getRadius(), 50, 50, &m_pSphereMesh, NULL)))
-			return false;
+		const D3DVERTEXELEMENT9 elements[] = {
+			{ 0, 0, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0 },
+			{ 0, 12, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL, 0 },
+			{ 1, 0, D3DDECLTYPE_FLOAT4, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 1 },
+			{ 1, 16, D3DDECLTYPE_FLOAT4, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 2 },
+			{ 1, 32, D3DDECLTYPE_FLOAT4, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 3 },
+			{ 1, 48, D3DDECLTYPE_FLOAT4, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 4 },
+			{ 1, 64, D3DDECLTYPE_D3DCOLOR, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_COLOR, 0 },
+			D3DDECL_END()
+		};
+		ID3DXBuffer* pCode = NULL;
+		bool ok = SUCCEEDED(pDevice->CreateVertexDeclaration(elements, &m_pDecl))
+			&& SUCCEEDED(pDevice->CreateVertexBuffer(capacity * sizeof(Instance), D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY,
+				0, D3DPOOL_DEFAULT, &m_pInstanceVB, NULL))
+			&& SUCCEEDED(D3DXCompileShader(g_sphereVS, (UINT)strlen(g_sphereVS), NULL, NULL, "main", "vs_3_0", 0,
+				&pCode, NULL, &m_pConstants))
+			&& SUCCEEDED(pDevice->CreateVertexShader((const DWORD*)pCode->GetBufferPointer(), &m_pVS));
+		d3d::Release<ID3DXBuffer*>(pCode);
+		pCode = NULL;
+		ok = ok && SUCCEEDED(D3DXCompileShader(g_spherePS, (UINT)strlen(g_spherePS), NULL, NULL, "main", "ps_3_0", 0,
+				&pCode, NULL, NULL))
+			&& SUCCEEDED(pDevice->CreatePixelShader((const DWORD*)pCode->GetBufferPointer(), &m_pPS));
+		d3d::Release<ID3DXBuffer*>(pCode);
+		if (!ok)
+			releaseInstancing();
 		return true;
 	}
 
 	void destroy(void)
 	{
-		if (m_pSphereMesh != NULL) {
-			m_pSphereMesh->Release();
-			m_pSphereMesh = NULL;
+		releaseInstancing();
+		for (int k = 0; k < LOD_LEVELS; k++) {
+			if (m_pMesh[k] != NULL) {
+				m_pMesh[k]->Release();
+				m_pMesh[k] = NULL;
+			}
 		}
 	}
 
-	void draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& mWorld)
-	{
-		if (NULL == pDevice)
-			return;
-		pDevice->SetTransform(D3DTS_WORLD, &mWorld);
-		pDevice->MultiplyTransform(D3DTS_WORLD, &m_mLocal);
-		pDevice->SetMaterial(&m_mtrl);
-		m_pSphereMesh->DrawSubset(0);
-	}
+	// start collecting the balls of a new frame
+	void begin(void) { m_instances.clear(); }
 
-	bool hasIntersected(CSphere& ball)
+	void add(const D3DXMATRIX& mWorld, const D3DXCOLOR& color)
 	{
-		// Insert your code here.
-		float x1 = this->center_x, z1 = this->center_z;
-		float x2 = ball.center_x, z2 = ball.center_z;
-		float dist = sqrt(pow((x1 - x2), 2) + pow((z1 - z2), 2));
-		if (dist <= (this->getRadius() + ball.getRadius()))
-		{
-			if (this->center_x >= ball.center_x && this->center_z >= ball.center_z) {
-				this->setCenter(this->center_x + M_RADIUS / 100, this->center_y, this->center_z + M_RADIUS / 100);
-				ball.setCenter(ball.center_x - M_RADIUS / 100, ball.center_y, ball.center_z - M_RADIUS / 100);
-			}
-			if (this->center_x >= ball.center_x && this->center_z <= ball.center_z) {
-				this->setCenter(this->center_x + M_RADIUS / 100, this->center_y, this->center_z - M_RADIUS / 100);
-				ball.setCenter(ball.center_x - M_RADIUS / 100, ball.center_y, ball.center_z + M_RADIUS / 100);
-			}
-			if (this->center_x <= ball.center_x && this->center_z >= ball.center_z) {
-				this->setCenter(this->center_x - M_RADIUS / 100, this->center_y, this->center_z + M_RADIUS / 100);
-				ball.setCenter(ball.center_x + M_RADIUS / 100, ball.center_y, ball.center_z - M_RADIUS / 100);
-			}
-			if (this->center_x <= ball.center_x && this->center_z <= ball.center_z) {
-				this->setCenter(this->center_x - M_RADIUS / 100, this->center_y, this->center_z - M_RADIUS / 100);
-				ball.setCenter(ball.center_x + M_RADIUS / 100, ball.center_y, ball.center_z + M_RADIUS / 100);
-			}
-			return true;
-		}
-		else
-			return false;
+		if ((int)m_instances.size() >= m_capacity)
+			return;
+		Instance inst;
+		inst.mWorld = mWorld;
+		inst.color = color;
+		m_instances.push_back(inst);
 	}
 
-	void hitBy(CSphere& ball)
+	// viewportHeight is in pixels; it turns projected size into pixels for the LOD choice
+	void draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& mView, const D3DXMATRIX& mProj, int viewportHeight,
+		const D3DXVECTOR3& lightPos, const D3DXVECTOR3& eyePos)
 	{
-		double checkX, checkZ;
-		float tempVelocity_X, tempVelocity_Z;
-		if (hasIntersected(ball)){
-			D3DXVECTOR2 *colVec = new D3DXVECTOR2((float)(ball.center_x - this->center_x), (float)(ball.center_z - this->center_z)),
-				*negColVec = new D3DXVECTOR2(-(float)(ball.center_x - this->center_x), -(float)(ball.center_z - this->center_z)),
-				*myVec = new D3DXVECTOR2((float)(this->getVelocity_X()), (float)(this->getVelocity_Z())),
-				*ballVec = new D3DXVECTOR2((float)(ball.getVelocity_X()), (float)(ball.getVelocity_Z()));
-
-
-			float size_col, size_my, size_ball;
-			size_col = sqrt(pow(colVec->x, 2) + pow(colVec->y, 2));
-			size_my = sqrt(pow(myVec->x, 2) + pow(myVec->y, 2));
-			size_ball = sqrt(pow(ballVec->x, 2) + pow(ballVec->y, 2));
+		if (NULL == pDevice || m_instances.empty())
+			return;
 
-			D3DXVECTOR2 *d1, *d2, *n1, *n2;   //colVec 좌표 상 벡터
-			d1 = new D3DXVECTOR2((*colVec) / size_col); //d1 벡터의 단위벡터
-			(*d1) *= (D3DXVec2Dot(colVec, myVec) / size_col);  // d1벡터의 크기
-			d2 = new D3DXVECTOR2((*negColVec) / size_col);
-			(*d2) *= (D3DXVec2Dot(negColVec, ballVec) / size_col);
-			n1 = new D3DXVECTOR2(*myVec - *d1);         //d1 + n1 = myVec
-			n2 = new D3DXVECTOR2(*ballVec - *d2);      //d2 + n2 = ballVec
+		// group the balls by level. m_sorted holds them level after level
+		int count[LOD_LEVELS] = { 0 }, first[LOD_LEVELS];
+		int* level = &m_level[0];
+		int n = (int)m_instances.size(), i, k;
+		float pixelsPerUnit = mProj._22 * viewportHeight * 0.5f;
+		for (i = 0; i < n; i++) {
+			const D3DXMATRIX& w = m_instances[i].mWorld;
+			float viewZ = w._41 * mView._13 + w._42 * mView._23 + w._43 * mView._33 + mView._43;
+			level[i] = chooseLevel(i, viewZ > 0 ? m_radius * pixelsPerUnit / viewZ : 1e6f);
+			count[level[i]]++;
+		}
+		for (k = 0, first[0] = 0; k + 1 < LOD_LEVELS; k++)
+			first[k + 1] = first[k] + count[k];
+		int fill[LOD_LEVELS];
+		memcpy(fill, first, sizeof(fill));
+		for (i = 0; i < n; i++)
+			m_sorted[fill[level[i]]++] = m_instances[i];
+
+		if (m_pVS == NULL) {
+			drawEach(pDevice, first, count);
+			return;
+		}
 
-			D3DXVECTOR2* myNewVec, *ballNewVec;
-			myNewVec = new D3DXVECTOR2(*d2 + *n1);
-			ballNewVec = new D3DXVECTOR2(*d1 + *n2);
+		void* pData = NULL;
+		UINT bytes = (UINT)(n * sizeof(Instance));
+		if (FAILED(m_pInstanceVB->Lock(0, bytes, &pData, D3DLOCK_DISCARD)))
+			return;
+		memcpy(pData, &m_sorted[0], bytes);
+		m_pInstanceVB->Unlock();
+
+		D3DXMATRIX mViewProj = mView * mProj;
+		D3DXVECTOR4 light(lightPos.x, lightPos.y, lightPos.z, 1.0f);
+		D3DXVECTOR4 eye(eyePos.x, eyePos.y, eyePos.z, 1.0f);
+		m_pConstants->SetMatrix(pDevice, "g_viewProj", &mViewProj);
+		m_pConstants->SetVector(pDevice, "g_lightPos", &light);
+		m_pConstants->SetVector(pDevice, "g_eyePos", &eye);
+
+		pDevice->SetVertexDeclaration(m_pDecl);
+		pDevice->SetVertexShader(m_pVS);
+		pDevice->SetPixelShader(m_pPS);
+		for (k = 0; k < LOD_LEVELS; k++) {
+			if (count[k] == 0)
+				continue;
+			ID3DXMesh* pMesh = m_pMesh[k];
+			IDirect3DVertexBuffer9* pVB = NULL;
+			IDirect3DIndexBuffer9* pIB = NULL;
+			pMesh->GetVertexBuffer(&pVB);
+			pMesh->GetIndexBuffer(&pIB);
+
+			pDevice->SetStreamSource(0, pVB, 0, pMesh->GetNumBytesPerVertex());
+			pDevice->SetStreamSourceFreq(0, D3DSTREAMSOURCE_INDEXEDDATA | (UINT)count[k]);
+			pDevice->SetStreamSource(1, m_pInstanceVB, first[k] * sizeof(Instance), sizeof(Instance));
+			pDevice->SetStreamSourceFreq(1, D3DSTREAMSOURCE_INSTANCEDATA | 1);
+			pDevice->SetIndices(pIB);
+			pDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, pMesh->GetNumVertices(), 0, pMesh->GetNumFaces());
+			pVB->Release();
+			pIB->Release();
+		}
 
+		// back to the fixed pipeline for everything else
+		pDevice->SetStreamSourceFreq(0, 1);
+		pDevice->SetStreamSourceFreq(1, 1);
+		pDevice->SetStreamSource(1, NULL, 0, 0);
+		pDevice->SetVertexShader(NULL);
+		pDevice->SetPixelShader(NULL);
+		pDevice->SetFVF(m_pMesh[0]->GetFVF());
+	}
 
+private:
+	struct Instance {
+		D3DXMATRIX      mWorld;
+		D3DCOLOR        color;
+	};
+
+	// coarsest level whose polygon silhouette is within half a pixel of the
+	// circle of radiusPx pixels: radiusPx * (1 - cos(PI / slices)) <= 0.5.
+	// a ball goes finer as soon as it needs to, but only goes coarser once the
+	// coarser level would be well inside the limit, so it does not flicker
+	// between two levels at the boundary
+	int chooseLevel(int slot, float radiusPx)
+	{
+		const float MAX_ERROR = 0.5f, COARSEN_ERROR = 0.35f;
+		int k = 0;
+		while (k + 1 < LOD_LEVELS && radiusPx * (1 - cos(PI / g_lodSlices[k + 1])) <= MAX_ERROR)
+			k++;
+		if (slot < (int)m_lastLevel.size()) {
+			int last = m_lastLevel[slot];
+			if (k > last && radiusPx * (1 - cos(PI / g_lodSlices[k])) > COARSEN_ERROR)
+				k = last;
+			m_lastLevel[slot] = k;
+		}
+		return k;
+	}
 
-			this->setPower(myNewVec->x, myNewVec->y);
-			ball.setPower(ballNewVec->x, ballNewVec->y);
+	void drawEach(IDirect3DDevice9* pDevice, const int* first, const int* count)
+	{
+		D3DMATERIAL9 mtrl;
+		ZeroMemory(&mtrl, sizeof(mtrl));
+		mtrl.Emissive = d3d::BLACK;
+		mtrl.Power = 5.0f;
+		for (int k = 0; k < LOD_LEVELS; k++) {
+			for (int i = first[k]; i < first[k] + count[k]; i++) {
+				D3DXCOLOR color(m_sorted[i].color);
+				mtrl.Ambient = color;
+				mtrl.Diffuse = color;
+				mtrl.Specular = color;
+				pDevice->SetTransform(D3DTS_WORLD, &m_sorted[i].mWorld);
+				pDevice->SetMaterial(&mtrl);
+				m_pMesh[k]->DrawSubset(0);
+			}
 		}
 	}
 
-	void ballUpdate(float timeDiff)
+	void releaseInstancing(void)
 	{
-		const float TIME_SCALE = 3.3;
-		D3DXVECTOR3 cord = this->getCenter();
-		double vx = abs(this->getVelocity_X());
-		double vz = abs(this->getVelocity_Z());
+		d3d::Release<IDirect3DVertexBuffer9*>(m_pInstanceVB);
+		d3d::Release<IDirect3DVertexDeclaration9*>(m_pDecl);
+		d3d::Release<IDirect3DVertexShader9*>(m_pVS);
+		d3d::Release<IDirect3DPixelShader9*>(m_pPS);
+		d3d::Release<ID3DXConstantTable*>(m_pConstants);
+		m_pInstanceVB = NULL;
+		m_pDecl = NULL;
+		m_pVS = NULL;
+		m_pPS = NULL;
+		m_pConstants = NULL;
+	}
 
-		if (vx > 0.01 || vz > 0.01)
-		{
-			float tX = cord.x + TIME_SCALE*timeDiff*m_velocity_x;
-			float tZ = cord.z + TIME_SCALE*timeDiff*m_velocity_z;
+	ID3DXMesh*                      m_pMesh[LOD_LEVELS];
+	float                           m_radius;
+	IDirect3DVertexBuffer9*         m_pInstanceVB;
+	IDirect3DVertexDeclaration9*    m_pDecl;
+	IDirect3DVertexShader9*         m_pVS;
+	IDirect3DPixelShader9*          m_pPS;
+	ID3DXConstantTable*             m_pConstants;
+	std::vector<Instance>           m_instances;
+	std::vector<Instance>           m_sorted;       // m_instances grouped by level
+	std::vector<int>                m_level;        // level of each slot this frame
+	std::vector<int>                m_lastLevel;    // level of each slot last frame
+	int                             m_capacity;
+};
 
+// -----------------------------------------------------------------------------
+// CSphere class definition
+// -----------------------------------------------------------------------------
+
+// CSphere only describes a ball to draw: its colour and center. position and
+// velocity of the balls on the table are owned by the simulation thread
+// (see simThread.h) and copied here from its snapshots before drawing. the mesh is shared through CSphereBatch.
+class CSphere {
+private:
+	float               center_x, center_y, center_z;
 
-			if (tX >= (4.5 - M_RADIUS))
-				tX = 4.5 - M_RADIUS;
-			else if (tX <= (-4.5 + M_RADIUS))
-				tX = -4.5 + M_RADIUS;
-			else if (tZ <= (-3 + M_RADIUS))
-				tZ = -3 + M_RADIUS;
-			else if (tZ >= (3 - M_RADIUS))
-				tZ = 3 - M_RADIUS;
+public:
+	CSphere(void)
+	{
+		center_x = center_y = center_z = 0;
+		m_color = d3d::WHITE;
+	}
+	~CSphere(void) {}
 
-			this->setCenter(tX, cord.y, tZ);
-		}
-		else { this->setPower(0, 0); }
-		//this->setPower(this->getVelocity_X() * DECREASE_RATE, this->getVelocity_Z() * DECREASE_RATE);
-		double rate = 1 - (1 - DECREASE_RATE)*timeDiff * 400;
-		if (rate < 0)
-			rate = 0;
-		this->setPower(getVelocity_X() * rate, getVelocity_Z() * rate);
+public:
+	void create(D3DXCOLOR color = d3d::WHITE)
+	{
+		m_color = color;
 	}
 
-	double getVelocity_X() { return this->m_velocity_x; }
-	double getVelocity_Z() { return this->m_velocity_z; }
+	void setColor(D3DXCOLOR color) { m_color = color; }
 
+	// queue this ball on batch. the world matrix is only built here, at draw time
+	void addTo(CSphereBatch& batch, const D3DXMATRIX& mWorld) const
+	{
+		D3DXMATRIX mLocal;
+		D3DXMatrixTranslation(&mLocal, center_x, center_y, center_z);
+		batch.add(mLocal * mWorld, m_color);
+	}
 
-	void setPower(double vx, double vz)
+	// position of ball i between two snapshots of the simulation: t = 0 at
+	// prev, 1 at cur. a ball that jumped (restart) is not slid
+	void setFrom(const sim::TableSnapshot& prev, const sim::TableSnapshot& cur, int i, float t)
 	{
-		this->m_velocity_x = vx;
-		this->m_velocity_z = vz;
+		float dx = cur.x[i] - prev.x[i], dz = cur.z[i] - prev.z[i];
+		if (dx * dx + dz * dz > 1)
+			t = 1;
+		setCenter(prev.x[i] + dx * t, (float)M_RADIUS, prev.z[i] + dz * t);
 	}
 
 	void setCenter(float x, float y, float z)
 	{
-		D3DXMATRIX m;
 		center_x = x;   center_y = y;   center_z = z;
-		D3DXMatrixTranslation(&m, x, y, z);
-		setLocalTransform(m);
 	}
 
 	float getRadius(void)  const { return (float)(M_RADIUS); }
-	const D3DXMATRIX& getLocalTransform(void) const { return m_mLocal; }
-	void setLocalTransform(const D3DXMATRIX& mLocal) { m_mLocal = mLocal; }
 	D3DXVECTOR3 getCenter(void) const
 	{
 		D3DXVECTOR3 org(center_x, center_y, center_z);
@@ -225,10 +393,7 @@ public:
 	}
 
 private:
-	D3DXMATRIX              m_mLocal;
-	D3DMATERIAL9            m_mtrl;
-	ID3DXMesh*              m_pSphereMesh;
-
+	D3DXCOLOR               m_color;
 };
 
 
@@ -237,6 +402,7 @@ private:
 // CWall class definition
 // -----------------------------------------------------------------------------
 
+// CWall only draws a cushion (or the plane). collision is done by sim::Cushions.
 class CWall {
 
 private:
@@ -293,38 +459,6 @@ public:
 		m_pBoundMesh->DrawSubset(0);
 	}
 
-	bool hasIntersected(CSphere& ball)
-	{
-		for (int i = 0; i < 4; i++){
-			if (abs(ball.getCenter().x) >= 4.29f || abs(ball.getCenter().z) >= 2.79f)
-				return true;
-		}
-		return false;
-	}
-
-	void hitBy(CSphere& ball)
-	{
-		D3DXVECTOR3   hitCenter = ball.getCenter();
-		if (this->hasIntersected(ball) == true){
-			if (ball.getCenter().x >= 4.29f){
-				ball.setCenter(4.29f, ball.getCenter().y, ball.getCenter().z);
-				ball.setPower(-abs(ball.getVelocity_X()), ball.getVelocity_Z());
-			}
-			else if (ball.getCenter().x <= -4.29f){
-				ball.setCenter(-4.29f, ball.getCenter().y, ball.getCenter().z);
-				ball.setPower(abs(ball.getVelocity_X()), ball.getVelocity_Z());
-			}
-			else if (ball.getCenter().z >= 2.79f){
-				ball.setCenter(ball.getCenter().x, ball.getCenter().y, 2.79f);
-				ball.setPower(ball.getVelocity_X(), -abs(ball.getVelocity_Z()));
-			}
-			else if (ball.getCenter().z <= -2.79f){
-				ball.setCenter(ball.getCenter().x, ball.getCenter().y, -2.79f);
-				ball.setPower(ball.getVelocity_X(), abs(ball.getVelocity_Z()));
-			}
-		}
-	}
-
 	void setPosition(float x, float y, float z)
 	{
 		D3DXMATRIX m;
@@ -439,9 +573,23 @@ private:
 // -----------------------------------------------------------------------------
 CWall   g_legoPlane;
 CWall   g_legowall[4];
-CSphere   g_sphere[4];
+CSphere   g_sphere[sim::Table::MAX_BALLS];
 CSphere   g_target_blueball;
+CSphereBatch   g_sphereBatch;
 CLight   g_light;
+sim::SimThread   g_sim;
+sim::Profiler   g_profiler;
+ID3DXFont*   g_pFont = NULL;
+
+// review of a recorded shot (trajectory.h), when the command line names a
+// trajectory file. the balls are drawn from it instead of the simulation
+sim::Trajectory   g_review;
+double   g_reviewTime = 0;
+bool   g_reviewPlaying = true;
+
+// with --trace on the command line, both threads keep every scope, written
+// to lastgame.trace.json on exit
+bool   g_tracing = false;
 
 double g_camera_pos[3] = { 0.0, 5.0, -8.0 };
 
@@ -467,25 +615,30 @@ bool Setup()
 	if (false == g_legoPlane.create(Device, -1, -1, 9, 0.03f, 6, d3d::GREEN)) return false;
 	g_legoPlane.setPosition(0.0f, -0.0006f / 5, 0.0f);
 
-	// create walls and set the position. note that there are four walls
-	if (false == g_legowall[0].create(Device, -1, -1, 9, 0.3f, 0.12f, d3d::DARKRED)) return false;
-	g_legowall[0].setPosition(0.0f, 0.12f, 3.06f);
-	if (false == g_legowall[1].create(Device, -1, -1, 9, 0.3f, 0.12f, d3d::DARKRED)) return false;
-	g_legowall[1].setPosition(0.0f, 0.12f, -3.06f);
-	if (false == g_legowall[2].create(Device, -1, -1, 0.12f, 0.3f, 6.24f, d3d::DARKRED)) return false;
-	g_legowall[2].setPosition(4.56f, 0.12f, 0.0f);
-	if (false == g_legowall[3].create(Device, -1, -1, 0.12f, 0.3f, 6.24f, d3d::DARKRED)) return false;
-	g_legowall[3].setPosition(-4.56f, 0.12f, 0.0f);
+	// create walls and set the position. note that there are four walls,
+	// the rails of sim::Table: (x, z, width, depth) of each wall
+	for (i = 0; i < 4; i++) {
+		const float* rail = sim::Table::RAILS[i];
+		if (false == g_legowall[i].create(Device, -1, -1, rail[2], 0.3f, rail[3], d3d::DARKRED)) return false;
+		g_legowall[i].setPosition(rail[0], 0.12f, rail[1]);
+	}
 
-	// create four balls and set the position
-	for (i = 0; i<4; i++) {
-		if (false == g_sphere[i].create(Device, sphereColor[i])) return false;
-		g_sphere[i].setCenter(spherePos[i][0], (float)M_RADIUS, spherePos[i][1]);
-		g_sphere[i].setPower(0, 0);
+	// create the balls and set the position. the simulation already holds
+	// them in the opening position
+	if (false == g_sphereBatch.create(Device, (float)M_RADIUS, sim::Table::MAX_BALLS + 1)) return false;
+	if (g_review.isOpen()) {
+		for (i = 0; i < g_review.ballCount(); i++)
+			g_sphere[i].create(ballColor(sim::rulesFor(g_review.game()), i));
+	}
+	else {
+		for (i = 0; i < g_sim.latest().ballCount; i++) {
+			g_sphere[i].create(ballColor(g_sim.rules(), i));
+			g_sphere[i].setFrom(g_sim.previous(), g_sim.latest(), i, 1);
+		}
 	}
 
 	// create blue ball for set direction
-	if (false == g_target_blueball.create(Device, d3d::BLUE)) return false;
+	g_target_blueball.create(d3d::BLUE);
 	g_target_blueball.setCenter(.0f, (float)M_RADIUS, .0f);
 
 	// light setting 
@@ -521,138 +674,180 @@ bool Setup()
 	Device->SetRenderState(D3DRS_SHADEMODE, D3DSHADE_GOURAUD);
 
 	g_light.setLight(Device, g_mWorld);
+
+	// font of the scoreboard / profiling overlay
+	if (FAILED(D3DXCreateFont(Device, 18, 0, FW_NORMAL, 1, FALSE, DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
+		DEFAULT_QUALITY, DEFAULT_PITCH | FF_DONTCARE, "Consolas", &g_pFont)))
+		return false;
+	g_profiler.bind();
+
+	// the table runs on its own thread from here on. a review plays no game
+	if (!g_review.isOpen())
+		g_sim.start();
 	return true;
 }
 
 void Cleanup(void)
 {
+	g_sim.stop();
 	g_legoPlane.destroy();
 	for (int i = 0; i < 4; i++) {
 		g_legowall[i].destroy();
 	}
+	g_sphereBatch.destroy();
+	d3d::Release<ID3DXFont*>(g_pFont);
+	g_pFont = NULL;
 	destroyAllLegoBlock();
 	g_light.destroy();
 }
 
 
+// ghost path of the shot being aimed, as a line strip just above the cloth
+void drawPreviewPath(IDirect3DDevice9* pDevice, const sim::ShotPreview::Path& path, D3DCOLOR color)
+{
+	struct Vertex {
+		float       x, y, z;
+		D3DCOLOR    color;
+	};
+
+	if (path.count < 2)
+		return;
+	Vertex v[sim::ShotPreview::MAX_POINTS];
+	for (int k = 0; k < path.count; k++) {
+		v[k].x = path.points[k].x;
+		v[k].y = 0.02f;
+		v[k].z = path.points[k].z;
+		v[k].color = color;
+	}
+	pDevice->DrawPrimitiveUP(D3DPT_LINESTRIP, path.count - 1, v, sizeof(Vertex));
+}
+
+// move the review to time seconds into the recording, paused. seeking
+// decodes at most one keyframe span, so holding a key scrubs smoothly
+void scrubReview(double time)
+{
+	g_reviewTime = time < 0 ? 0 : (time > g_review.duration() ? g_review.duration() : time);
+	g_reviewPlaying = false;
+}
+
 // timeDelta represents the time between the current image frame and the last image frame.
 // the distance of moving balls should be "velocity * timeDelta"
 
-bool isBtnPressed = false;
-bool isStop = true;
-bool whiteTurn = true;
-int w_score = 0, y_score = 0;
 bool tabPressed = false;
 
 bool Display(float timeDelta)
 {
 	int i = 0;
-	int j = 0;
-	static bool status[4][4] = { false };
 	
 
 	if (Device)
 	{
+		g_profiler.beginFrame();
 		Device->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0x00afafaf, 1.0f, 0);
 		Device->BeginScene();
 
-		// update the position of each ball. during update, check whether each ball hit by walls.
-		for (i = 0; i < 4; i++) {
-			g_sphere[i].ballUpdate(timeDelta);
-			for (j = 0; j < 4; j++){ g_legowall[i].hitBy(g_sphere[j]); }
-		}
-
-		// check whether any two balls hit together and update the direction of balls
+		// balls move, collide and get scored on the simulation thread. take
+		// its latest snapshot and draw one tick behind it, between the last two
 		// 0 1 2 3 빨 빨 노 흰
-		for (i = 0; i < 4; i++){
-			for (j = 0; j < 4; j++) {		
-				if (i >= j) { continue; }
-				if (g_sphere[i].hasIntersected((g_sphere[j]))){
-					status[i][j] = true;
-					status[j][i] = true;
+		g_sim.update();
+		const sim::TableSnapshot& prev = g_sim.previous();
+		const sim::TableSnapshot& cur = g_sim.latest();
+		float t = (float)((g_sim.now() - cur.time) / g_sim.period());
+		t = t < 0 ? 0 : (t > 1 ? 1 : t);
+		g_target_blueball.setCenter(cur.aimX, (float)M_RADIUS, cur.aimZ);
+
+		// draw plane, walls, and spheres. all balls go out in one instanced call
+		{
+			PROFILE_SCOPE("draw table");
+			g_legoPlane.draw(Device, g_mWorld);
+			for (i = 0; i<4; i++)    {
+				g_legowall[i].draw(Device, g_mWorld);
+			}
+		}
+		{
+			PROFILE_SCOPE("draw balls");
+			g_sphereBatch.begin();
+			if (g_review.isOpen()) {
+				if (g_reviewPlaying && (g_reviewTime += timeDelta) >= g_review.duration()) {
+					g_reviewTime = g_review.duration();
+					g_reviewPlaying = false;
 				}
-				g_sphere[i].hitBy(g_sphere[j]);
+				float xz[2 * sim::Table::MAX_BALLS];
+				g_review.at(g_reviewTime, xz);
+				for (i = 0; i < g_review.ballCount(); i++) {
+					g_sphere[i].setCenter(xz[2 * i], (float)M_RADIUS, xz[2 * i + 1]);
+					g_sphere[i].addTo(g_sphereBatch, g_mWorld);
+				}
+			}
+			else {
+				for (i = 0; i < cur.ballCount; i++) {
+					g_sphere[i].setFrom(prev, cur, i, t);
+					g_sphere[i].addTo(g_sphereBatch, g_mWorld);
+				}
+				g_target_blueball.addTo(g_sphereBatch, g_mWorld);
 			}
+			D3DXVECTOR3 eye((float)g_camera_pos[0], (float)g_camera_pos[1], (float)g_camera_pos[2]);
+			g_sphereBatch.draw(Device, g_mView, g_mProj, Height, g_light.getPosition(), eye);
+		}
+		if (cur.stopped && !g_review.isOpen()) {
+			PROFILE_SCOPE("draw preview");
+			Device->SetTransform(D3DTS_WORLD, &g_mWorld);
+			Device->SetRenderState(D3DRS_LIGHTING, FALSE);
+			Device->SetFVF(D3DFVF_XYZ | D3DFVF_DIFFUSE);
+			drawPreviewPath(Device, cur.preview.cue, ballColor(g_sim.rules(), cur.cueBall));
+			if (cur.preview.object.ball >= 0)
+				drawPreviewPath(Device, cur.preview.object, ballColor(g_sim.rules(), cur.preview.object.ball));
+			Device->SetRenderState(D3DRS_LIGHTING, TRUE);
+		}
+		{
+			PROFILE_SCOPE("draw light");
+			g_light.draw(Device);
 		}
 
 		///////////////show scoreboard
 		if (tabPressed){
-
-			// system("pause");
-
-
-			tabPressed = false;
+			char text[4096];
+			int len;
+			if (g_review.isOpen())
+				len = snprintf(text, sizeof(text), "review %.2f / %.2f s%s\n\n",
+					g_reviewTime, g_review.duration(), g_reviewPlaying ? "" : "   (paused)");
+			else if (cur.aimPredicted)
+				len = snprintf(text, sizeof(text), "white %d   yellow %d   (%s to play, aimed shot %+d)\n\n",
+					cur.whiteScore, cur.yellowScore, cur.whiteTurn ? "white" : "yellow", cur.aimPoints);
+			else
+				len = snprintf(text, sizeof(text), "white %d   yellow %d   (%s to play)\n\n",
+					cur.whiteScore, cur.yellowScore, cur.whiteTurn ? "white" : "yellow");
+			len += g_profiler.formatOverlay(text + len, sizeof(text) - len);
+			if (!g_review.isOpen())
+				snprintf(text + len, sizeof(text) - len, "\nsimulation, per tick\n%s", cur.profile);
+			RECT rc;
+			SetRect(&rc, 16, 16, Width, Height);
+			g_pFont->DrawText(NULL, text, -1, &rc, DT_LEFT | DT_TOP | DT_NOCLIP, D3DCOLOR_XRGB(0, 0, 0));
 		}
 		///////////////show scoreboard
 
-
-		//all ball stop
-		isStop = true;
-		for (int k = 0; k < 4; k++){
-			if (g_sphere[k].getVelocity_X() != 0 || g_sphere[k].getVelocity_Z() != 0){
-				isStop = false;
-			}
-		}
-		
-
-
-		int scoreDelta = 0;
-		if (isStop){
-			if (status[2][3]){
-				scoreDelta = -10;
-			}
-			else if (status[0][3] && status[1][3]){
-				scoreDelta = 10;
-			}
-
-			if (whiteTurn){
-				w_score += scoreDelta;
-			}
-			else{
-				y_score += scoreDelta;
-			}
-
-
-			for (int a = 0; a < 4; a++){
-				for (int b = 0; b < 4; b++){
-					status[a][b] = false;
-				}
-			}
-
-			if (isBtnPressed && scoreDelta <= 0){
-				CSphere temp;
-				temp = g_sphere[3];
-				g_sphere[3] = g_sphere[2];
-				g_sphere[2] = temp;
-				whiteTurn = !whiteTurn;
-			}
-			isBtnPressed = false;
-			///////////////show whose turn now
-
-
-
-
-			///////////////show whose turn now
-		}
-		
-
-		// draw plane, walls, and spheres
-		g_legoPlane.draw(Device, g_mWorld);
-		for (i = 0; i<4; i++)    {
-			g_legowall[i].draw(Device, g_mWorld);
-			g_sphere[i].draw(Device, g_mWorld);
+		{
+			PROFILE_SCOPE("present");
+			Device->EndScene();
+			Device->Present(0, 0, 0, 0);
+			Device->SetTexture(0, NULL);
 		}
-		g_target_blueball.draw(Device, g_mWorld);
-		g_light.draw(Device);
-
-		Device->EndScene();
-		Device->Present(0, 0, 0, 0);
-		Device->SetTexture(0, NULL);
+		g_profiler.endFrame();
 	}
 	return true;
 }
 
 
+// hand an input to the simulation thread. it is applied at its next tick
+void postInput(sim::TableInput::Type type, float x, float z)
+{
+	sim::TableInput input;
+	input.type = type;
+	input.x = x;
+	input.z = z;
+	g_sim.post(input);
+}
+
 LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
 	static bool wire = false;
@@ -664,30 +859,33 @@ LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	switch (msg) {
 	case WM_DESTROY:
 	{
+					   g_sim.stop();
+					   // keep the last replay unless this run played no game
+					   if (!g_review.isOpen() && g_sim.table().replay().inputCount() > 0)
+						   g_sim.table().replay().save("lastgame.vlr");
+					   if (g_tracing) {
+						   const sim::Profiler* profilers[] = { &g_profiler, &g_sim.profiler() };
+						   sim::Profiler::writeChromeTrace("lastgame.trace.json", profilers, 2);
+					   }
 					   ::PostQuitMessage(0);
 					   break;
 	}
+	case WM_KEYUP:
+	{
+					   if (wParam == 9)				//scoreboard stays up while tab is held
+						   tabPressed = false;
+					   break;
+	}
 	case WM_KEYDOWN:
 	{
 					   
 					   switch (wParam) {
 					   case 82:					//regame (key R)
-						   if (!whiteTurn){
-							   CSphere temp;
-							   temp = g_sphere[3];
-							   g_sphere[3] = g_sphere[2];
-							   g_sphere[2] = temp;
-						   }
-						   isBtnPressed = false;
-						   isStop = true;
-						   whiteTurn = true;
-						   w_score = 0, y_score = 0;
-
-						   for (int i = 0; i < 4; i++){
-							   g_sphere[i].setCenter(spherePos[i][0], g_sphere[i].getCenter().y, spherePos[i][1]);
-							   g_sphere[i].setPower(0, 0);
-						   }
-
+						   postInput(sim::TableInput::RESTART, 0, 0);
+						   break;
+					   case 67:					//the computer plays this shot (key C). ignored while balls move
+						   if (!g_review.isOpen())
+							   postInput(sim::TableInput::COMPUTER, 0, 0);
 						   break;
 					   case 9:					//show score while pressing (tab key)
 						   tabPressed = true;
@@ -703,21 +901,28 @@ LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 								   (wire ? D3DFILL_WIREFRAME : D3DFILL_SOLID));
 						   }
 						   break;
-					   case VK_SPACE:
-						   if (!isStop){
-							   break;
+					   case VK_SPACE:			//shoot toward the blue ball. ignored while balls move
+						   if (g_review.isOpen()) {			//review: play / pause, from the start once at the end
+							   if (!g_reviewPlaying && g_reviewTime >= g_review.duration())
+								   g_reviewTime = 0;
+							   g_reviewPlaying = !g_reviewPlaying;
 						   }
-						   D3DXVECTOR3 targetpos = g_target_blueball.getCenter();
-						   D3DXVECTOR3   whitepos = g_sphere[3].getCenter();
-						   double theta = acos(sqrt(pow(targetpos.x - whitepos.x, 2)) / sqrt(pow(targetpos.x - whitepos.x, 2) + pow(targetpos.z - whitepos.z, 2)));      // 기본 1 사분면
-						   if (targetpos.z - whitepos.z <= 0 && targetpos.x - whitepos.x >= 0) { theta = -theta; }   //4 사분면
-						   if (targetpos.z - whitepos.z >= 0 && targetpos.x - whitepos.x <= 0) { theta = PI - theta; } //2 사분면
-						   if (targetpos.z - whitepos.z <= 0 && targetpos.x - whitepos.x <= 0){ theta = PI + theta; } // 3 사분면
-						   double distance = sqrt(pow(targetpos.x - whitepos.x, 2) + pow(targetpos.z - whitepos.z, 2));
-						   g_sphere[3].setPower(distance * cos(theta), distance * sin(theta));
-						   isBtnPressed = true;
+						   else
+							   postInput(sim::TableInput::SHOOT, 0, 0);
 
 						   break;
+					   case VK_LEFT:			//review: scrub back / forward a tenth of a second, held to repeat
+						   if (g_review.isOpen())
+							   scrubReview(g_reviewTime - 0.1);
+						   break;
+					   case VK_RIGHT:
+						   if (g_review.isOpen())
+							   scrubReview(g_reviewTime + 0.1);
+						   break;
+					   case VK_HOME:
+						   if (g_review.isOpen())
+							   scrubReview(0);
+						   break;
 
 					  
 					   }
@@ -767,8 +972,7 @@ LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 								 dx = (old_x - new_x);// * 0.01f;
 								 dy = (old_y - new_y);// * 0.01f;
 
-								 D3DXVECTOR3 coord3d = g_target_blueball.getCenter();
-								 g_target_blueball.setCenter(coord3d.x + dx*(-0.007f), coord3d.y, coord3d.z + dy*0.007f);
+								 postInput(sim::TableInput::AIM, dx*(-0.007f), dy*0.007f);
 							 }
 							 old_x = new_x;
 							 old_y = new_y;
@@ -789,6 +993,23 @@ int WINAPI WinMain(HINSTANCE hinstance,
 {
 	srand(static_cast<unsigned int>(time(NULL)));
 
+	// a trajectory file on the command line (tableServer --record) is
+	// played back instead of a game
+	if (cmdLine != NULL && strcmp(cmdLine, "--trace") == 0) {
+		g_tracing = true;
+		g_profiler.setTracing(true);
+		g_sim.setTracing(true);
+	}
+	else if (cmdLine != NULL && cmdLine[0] != 0) {
+		std::string path(cmdLine);
+		if (path.size() >= 2 && path[0] == '"' && path[path.size() - 1] == '"')
+			path = path.substr(1, path.size() - 2);
+		if (!g_review.open(path.c_str()) || g_review.ballCount() > sim::Table::MAX_BALLS) {
+			::MessageBox(0, ("cannot review " + path).c_str(), 0, 0);
+			return 0;
+		}
+	}
+
 	if (!d3d::InitD3D(hinstance,
 		Width, Height, true, D3DDEVTYPE_HAL, &Device))
 	{